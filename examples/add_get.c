@@ -1,8 +1,8 @@
-#include <stdio.h>
-
 #define JACK_IMPLEMENTATION
 #include <jack.h>
 
+#include <stdio.h>
+
 int main(void)
 {
   jjson_t json;
@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <memory_resource>
+
+#define JACK_IMPLEMENTATION
+#include "../jack.hpp"
+
+int main()
+{
+  const char text[] = R"({"name": "jack", "id": 18446744073709551615, "tags": ["c", "c++"], "meta": {"stars": 42, "fast": true}})";
+
+  // raw numbers keep a copy of the text, taken from the arena below
+  std::pmr::monotonic_buffer_resource arena;
+  jack::Document doc = jack::Document::parse(text, JJSON_PARSE_RAW_NUMBERS, &arena);
+
+  std::string_view name = doc["name"].get<std::string_view>();
+  std::printf("name: %.*s\n", (int)name.size(), name.data());
+  std::printf("id: %.*s\n", (int)doc["id"].raw().size(), doc["id"].raw().data());
+
+  for (jack::Value tag : doc["tags"].get<jack::Array>())
+  {
+    std::string_view s = tag.get<std::string_view>();
+    std::printf("tag: %.*s\n", (int)s.size(), s.data());
+  }
+
+  for (auto [key, value] : doc["meta"].get<jack::Object>())
+  {
+    if (value.is<int>())
+      std::printf("%.*s: %d\n", (int)key.size(), key.data(), value.get<int>());
+    else if (value.is<bool>())
+      std::printf("%.*s: %s\n", (int)key.size(), key.data(), value.get<bool>() ? "true" : "false");
+  }
+
+  try
+  {
+    doc["id"].get<long long>();
+  }
+  catch (const jack::Error &e)
+  {
+    std::printf("id: %s\n", e.what());
+  }
+
+  std::puts(doc.stringify(1).c_str());
+
+  // `text` outlives `view`, so its raw numbers can point into it directly
+  jack::Document view = jack::Document::parse(jack::borrow, text, JJSON_PARSE_RAW_NUMBERS);
+  std::printf("same document: %s\n", view == doc ? "yes" : "no");
+}
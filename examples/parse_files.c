@@ -0,0 +1,27 @@
+#define JACK_IMPLEMENTATION
+#include "../jack.h"
+
+#include <stdio.h>
+
+void on_file(size_t index, const char *path, jjson_t *json, enum jjson_error err, void *user_data)
+{
+  (void)index;
+  (void)user_data;
+  if (err != JJE_OK)
+  {
+    fprintf(stderr, "%s: %s\n", path, jjson_strerror());
+    return;
+  }
+  printf("%s: %zu fields\n", path, json->field_count);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <file.json>...\n", argv[0]);
+    return 1;
+  }
+  // 0 threads means one worker per online CPU
+  jjson_parse_files((const char *const *)(argv + 1), argc - 1, 0, JJSON_PARSE_DEFAULT, on_file, NULL);
+}
@@ -1,11 +1,11 @@
+#define JACK_IMPLEMENTATION
+#include "../jack.h"
+
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define JACK_IMPLEMENTATION
-#include "../jack.h"
-
 char *read_file_to_buf(char *path)
 {
   FILE *file = fopen(path, "r");
@@ -1,7 +1,15 @@
 #ifndef __JACK_JSON_PARSER__
 #define __JACK_JSON_PARSER__
 
+// the implementation uses open_memstream, pread, syscall and other POSIX/Linux
+// interfaces that a strict -std=c11 hides. This only takes effect when the
+// file defining JACK_IMPLEMENTATION includes jack.h before any system header.
+#if defined(JACK_IMPLEMENTATION) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <ctype.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,6 +37,8 @@ typedef enum
   JJSON_OBJECT = 4,
   JJSON_NULL = 5,
   JJSON_BOOLEAN = 6,
+  // number kept as its source text, see JJSON_PARSE_RAW_NUMBERS
+  JJSON_RAW_NUMBER = 7,
 } jjson_type;
 
 typedef struct
@@ -41,6 +51,9 @@ typedef struct
 typedef struct jjson_value
 {
   jjson_type type;
+  // JJSON_IN_ARENA_* bits for strings the library placed in a document's
+  // arena; jjson_add and jjson_array_push clear them on caller-built values
+  unsigned char in_arena;
   union
   {
     long long number;
@@ -48,6 +61,18 @@ typedef struct jjson_value
     jjson_array array;
     struct jjson_t *object;
     jjson_bool boolean;
+    struct
+    {
+      const char *text;
+      unsigned int length;
+      // which member of the union below holds the converted text, 0 for none
+      unsigned char cached;
+      union
+      {
+        long long integer;
+        double real;
+      };
+    } raw_number;
   } data;
 } jjson_value;
 
@@ -57,52 +82,181 @@ typedef struct
   jjson_value value;
 } jjson_key_value;
 
+enum jjson_in_arena
+{
+  // data.string of the value
+  JJSON_IN_ARENA_STRING = 1 << 0,
+  // key of the jjson_key_value holding the value
+  JJSON_IN_ARENA_KEY = 1 << 1,
+};
+
 typedef struct jjson_t
 {
   size_t capacity;
   size_t field_count;
   jjson_key_value *fields;
+  // structural hash cached by jjson_parse_ex(JJSON_PARSE_HASH), 0 when unknown.
+  // jjson_add clears it on the object and all its ancestors; see
+  // jjson_invalidate_hash for edits made through pointers into the tree.
+  unsigned long long hash;
+  // object holding this one, directly or through arrays, NULL for a root
+  struct jjson_t *parent;
+  // free lists and string arena shared by the whole tree once jjson_reset
+  // has been called on the root, NULL before that
+  struct jjson__pool *pool;
 } jjson_t;
 
+enum jjson_parse_flags
+{
+  JJSON_PARSE_DEFAULT = 0,
+  // compute the structural hash of every object while parsing it
+  JJSON_PARSE_HASH = 1 << 0,
+  // keep numbers as JJSON_RAW_NUMBER pointing into the parsed content, which
+  // must then outlive the document; they are converted by the typed getters
+  JJSON_PARSE_RAW_NUMBERS = 1 << 1,
+};
+
+enum jjson_stringify_flags
+{
+  JJSON_STRINGIFY_DEFAULT = 0,
+  // escape every non-ASCII character as \uXXXX so the output is pure ASCII
+  JJSON_STRINGIFY_ASCII = 1 << 0,
+};
+
 enum jjson_error
 {
   JJE_OK = 0,
   JJE_ALLOC_FAIL = -1,
   JJE_NOT_FOUND = -2,
   JJE_INVALID_TKN = -3,
+  JJE_IO_FAIL = -4,
+  JJE_TYPE_MISMATCH = -5,
+  JJE_OUT_OF_RANGE = -6,
 };
 
+// nesting deeper than this is rejected by jjson_validate and jjson_scan
+#define JJSON_SCAN_MAX_DEPTH 1024
+
+/*
+ * State of jjson_scan over a sequence of values such as NDJSON. Offsets are
+ * into the buffer given to jjson_scan, so a caller that drops consumed input
+ * from the front of its buffer subtracts the dropped length from `pos` and
+ * `start`.
+ */
+typedef struct
+{
+  // where the next call resumes, always at a token boundary
+  size_t pos;
+  // start of the value being scanned, `pos` between values
+  size_t start;
+  size_t depth;
+  int state;
+  // one bit per open container: 1 for objects, 0 for arrays
+  unsigned char stack[JJSON_SCAN_MAX_DEPTH / 8];
+} jjson_scanner;
+
 enum jjson_error jjson_init(jjson_t *json);
 enum jjson_error jjson_init_array(jjson_array *arr);
 
 enum jjson_error jjson_parse(jjson_t *json, const char *content, size_t content_len);
+enum jjson_error jjson_parse_ex(jjson_t *json, const char *content, size_t content_len, unsigned flags);
+enum jjson_error jjson_validate(const char *content, size_t content_len, size_t *error_offset);
+void jjson_scanner_init(jjson_scanner *sc);
+enum jjson_error jjson_scan(jjson_scanner *sc, const char *content, size_t content_len, int more, size_t *start, size_t *end);
+size_t jjson_unescape(const char *s, size_t len, char *out);
+enum jjson_error jjson_minify(const char *in, size_t in_len, char *out, size_t *out_len);
+enum jjson_error jjson_prettify(const char *in, size_t in_len, FILE *out, int indent);
 enum jjson_error jjson_stringify(const jjson_t *obj, short depth, char **out);
+enum jjson_error jjson_stringify_ex(const jjson_t *obj, short depth, unsigned flags, char **out);
 
 enum jjson_error jjson_get(jjson_t *json, const char *key, jjson_value **out);
 enum jjson_error jjson_get_string(jjson_t *json, const char *key, char **out);
 enum jjson_error jjson_get_number(jjson_t *json, const char *key, long long **out);
+enum jjson_error jjson_get_int64(jjson_t *json, const char *key, long long *out);
+enum jjson_error jjson_get_double(jjson_t *json, const char *key, double *out);
+enum jjson_error jjson_get_raw_number(jjson_t *json, const char *key, const char **text, size_t *length);
+
+enum jjson_error jjson_value_int64(jjson_value *val, long long *out);
+enum jjson_error jjson_value_double(jjson_value *val, double *out);
 
 enum jjson_error jjson_add(jjson_t *json, jjson_key_value kv);
 enum jjson_error jjson_add_string(jjson_t *json, const char *key, const char *value);
 enum jjson_error jjson_add_number(jjson_t *json, const char *key, const long long value);
 enum jjson_error jjson_array_push(jjson_array *array, jjson_value val);
 
+enum jjson_error jjson_reset(jjson_t *json);
 enum jjson_error jjson_deinit(jjson_t *json);
 enum jjson_error jjson_deinit_object(jjson_t *json);
 enum jjson_error jjson_deinit_array(jjson_array *arr);
 enum jjson_error jjson_deinit_value(jjson_value *val);
 
+unsigned long long jjson_hash(const jjson_t *json);
+void jjson_invalidate_hash(jjson_t *json);
+jjson_bool jjson_equal(const jjson_t *a, const jjson_t *b);
+
 char *jjson_strerror();
 void jjson_dump(const jjson_t *json, FILE *f, int depth);
 
+#if defined(__linux__)
+/*
+ * Called from the worker threads of jjson_parse_files once per file. `json` is
+ * NULL when the file could not be read or parsed (see jjson_strerror) and is
+ * only valid until the callback returns.
+ */
+typedef void (*jjson_file_callback)(size_t index, const char *path, jjson_t *json, enum jjson_error err, void *user_data);
+
+enum jjson_error jjson_parse_files(const char *const *paths, size_t count, size_t n_threads, unsigned flags, jjson_file_callback callback, void *user_data);
+
+enum jjson_error jjson_stringify_parallel(const jjson_t *obj, short depth, unsigned flags, size_t n_threads, char **out);
+enum jjson_error jjson_write_parallel(const jjson_t *obj, short depth, unsigned flags, size_t n_threads, int fd);
+#endif
+
 #ifdef JACK_IMPLEMENTATION
 
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
+// define JACK_NO_SIMD to build only the scalar paths, e.g. to compare them with the vector ones
+#if !defined(JACK_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JJSON__AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JJSON__SSE2 1
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define JJSON__SSSE3 1
+#endif
+#endif
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// define JACK_NO_IO_URING to read files with pread only
+#if !defined(JACK_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// kernel headers older than 5.4 lack parts of the ring interface used here
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_SINGLE_MMAP)
+#define JJSON__IO_URING 1
+#endif
+#endif
+#endif
+#endif
+
 #define JJSON__MAX_STR_LEN (32 * 1024)
 #define JJSON__ERROR_MSG_MAX_LEN 1024
-char jjson__last_error_message[JJSON__ERROR_MSG_MAX_LEN];
+__thread char jjson__last_error_message[JJSON__ERROR_MSG_MAX_LEN];
 char *jjson_strerror() { return jjson__last_error_message; }
 
 #define JSON_CAPACITY_INCR_RATE 256
@@ -123,6 +277,7 @@ typedef enum
   JJSON__TOKEN_NULL = -5,
   JJSON__TOKEN_TRUE = -6,
   JJSON__TOKEN_FALSE = -7,
+  JJSON__TOKEN_BAD_STRING = -8,
 
   JJSON__TOKEN_COLON = ':',
   JJSON__TOKEN_COMMA = ',',
@@ -141,22 +296,28 @@ typedef struct
     char chr;
     long number;
     unsigned int boolean;
+    struct
+    {
+      const char *text;
+      size_t length;
+    } raw;
   } label;
   jjson__tkn_pos pos;
 } jjson__token;
 
-#define JJSON__TOKEN_TYPE(tt)                            \
-  ((tt) == JJSON__TOKEN_EOF       ? "EOF"                \
-   : (tt) == JJSON__TOKEN_INVALID ? "Invalid JSON token" \
-   : (tt) == JJSON__TOKEN_STRING  ? "String"             \
-   : (tt) == JJSON__TOKEN_NUMBER  ? "Number"             \
-   : (tt) == JJSON__TOKEN_COMMA   ? ","                  \
-   : (tt) == JJSON__TOKEN_COLON   ? ":"                  \
-   : (tt) == JJSON__TOKEN_LBRACE  ? "{"                  \
-   : (tt) == JJSON__TOKEN_RBRACE  ? "}"                  \
-   : (tt) == JJSON__TOKEN_LPAREN  ? "["                  \
-   : (tt) == JJSON__TOKEN_RPAREN  ? "]"                  \
-                                  : "Unkown JSON type")
+#define JJSON__TOKEN_TYPE(tt)                                \
+  ((tt) == JJSON__TOKEN_EOF          ? "EOF"                 \
+   : (tt) == JJSON__TOKEN_INVALID    ? "Invalid JSON token"  \
+   : (tt) == JJSON__TOKEN_BAD_STRING ? "Invalid JSON string" \
+   : (tt) == JJSON__TOKEN_STRING     ? "String"              \
+   : (tt) == JJSON__TOKEN_NUMBER     ? "Number"              \
+   : (tt) == JJSON__TOKEN_COMMA      ? ","                   \
+   : (tt) == JJSON__TOKEN_COLON      ? ":"                   \
+   : (tt) == JJSON__TOKEN_LBRACE     ? "{"                   \
+   : (tt) == JJSON__TOKEN_RBRACE     ? "}"                   \
+   : (tt) == JJSON__TOKEN_LPAREN     ? "["                   \
+   : (tt) == JJSON__TOKEN_RPAREN     ? "]"                   \
+                                     : "Unkown JSON type")
 
 typedef struct
 {
@@ -169,6 +330,9 @@ typedef struct
 
   size_t pos;
   size_t read_pos;
+
+  int raw_numbers;
+  struct jjson__pool *pool;
 } jjson__lexer;
 
 typedef struct
@@ -176,6 +340,10 @@ typedef struct
   jjson__lexer lexer;
   jjson__token curr_token;
   jjson__token next_token;
+  unsigned flags;
+  unsigned long long value_hash;
+  // innermost object being parsed, the parent of objects found inside it
+  jjson_t *object;
 } jjson__parser;
 
 typedef struct
@@ -183,16 +351,318 @@ typedef struct
   FILE *stream;
   size_t tab;
   size_t tab_rate;
+  unsigned flags;
 } jjson__stringfier;
 
 void jjson__lexer_init(jjson__lexer *l, const char *content, size_t content_len);
 void jjson__lexer_next_token(jjson__lexer *l, jjson__token *tkn);
 
+/**
+ * Document Pooling
+ */
+
+#define JJSON__POOL_CHUNK_SIZE (16 * 1024)
+
+typedef struct jjson__pool_chunk
+{
+  struct jjson__pool_chunk *next;
+  size_t size;
+  size_t used;
+} jjson__pool_chunk;
+
+/*
+ * Free lists are queues filled in document order and consumed from the front,
+ * so parsing the same shape again gets back the very buffers it used before.
+ */
+struct jjson__pool
+{
+  // emptied child objects, each keeps its fields buffer
+  jjson_t **objects;
+  size_t object_taken;
+  size_t object_count;
+  size_t object_capacity;
+  // emptied arrays, each keeps its items buffer
+  jjson_array *arrays;
+  size_t array_taken;
+  size_t array_count;
+  size_t array_capacity;
+  // string arena, rewound by jjson_reset
+  jjson__pool_chunk *chunks;
+  jjson__pool_chunk *current;
+};
+
+struct jjson__pool *jjson__pool_new(void);
+void jjson__pool_free(struct jjson__pool *pool);
+jjson__pool_chunk *jjson__pool_new_chunk(size_t size);
+char *jjson__pool_alloc_string(struct jjson__pool *pool, size_t size);
+char *jjson__pool_strdup(struct jjson__pool *pool, const char *str);
+size_t jjson__bounded_strlen(const char *str);
+jjson_t *jjson__pool_object(struct jjson__pool *pool);
+enum jjson_error jjson__pool_array(struct jjson__pool *pool, jjson_array *arr);
+void jjson__pool_recycle_object(struct jjson__pool *pool, jjson_t *json);
+void jjson__pool_recycle_value(struct jjson__pool *pool, jjson_value *val);
+void jjson__pool_rewind_arena(struct jjson__pool *pool);
+
+jjson__pool_chunk *jjson__pool_new_chunk(size_t size)
+{
+  jjson__pool_chunk *chunk = (jjson__pool_chunk *)malloc(sizeof(jjson__pool_chunk) + size);
+  if (!chunk)
+    return NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+struct jjson__pool *jjson__pool_new(void)
+{
+  struct jjson__pool *pool = (struct jjson__pool *)calloc(1, sizeof(struct jjson__pool));
+  if (!pool)
+    return NULL;
+  pool->chunks = jjson__pool_new_chunk(JJSON__POOL_CHUNK_SIZE);
+  if (!pool->chunks)
+  {
+    free(pool);
+    return NULL;
+  }
+  pool->current = pool->chunks;
+  return pool;
+}
+
+void jjson__pool_free(struct jjson__pool *pool)
+{
+  for (size_t i = pool->object_taken; i < pool->object_count; ++i)
+  {
+    free(pool->objects[i]->fields);
+    free(pool->objects[i]);
+  }
+  for (size_t i = pool->array_taken; i < pool->array_count; ++i)
+  {
+    free(pool->arrays[i].items);
+  }
+  jjson__pool_chunk *chunk = pool->chunks;
+  while (chunk)
+  {
+    jjson__pool_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(pool->objects);
+  free(pool->arrays);
+  free(pool);
+}
+
+// Falls back to malloc for documents that were never reset
+char *jjson__pool_alloc_string(struct jjson__pool *pool, size_t size)
+{
+  if (!pool)
+    return (char *)malloc(size);
+  jjson__pool_chunk *chunk = pool->current;
+  while (chunk->size - chunk->used < size)
+  {
+    if (!chunk->next)
+    {
+      chunk->next = jjson__pool_new_chunk(MAX(chunk->size * 2, size));
+      if (!chunk->next)
+        return NULL;
+    }
+    chunk = chunk->next;
+  }
+  pool->current = chunk;
+  char *out = (char *)(chunk + 1) + chunk->used;
+  chunk->used += size;
+  return out;
+}
+
+// strlen capped at JJSON__MAX_STR_LEN, which is where added strings are cut
+size_t jjson__bounded_strlen(const char *str)
+{
+  size_t len = 0;
+  while (len < JJSON__MAX_STR_LEN && str[len])
+    len += 1;
+  return len;
+}
+
+char *jjson__pool_strdup(struct jjson__pool *pool, const char *str)
+{
+  size_t len = jjson__bounded_strlen(str);
+  char *out = jjson__pool_alloc_string(pool, len + 1);
+  if (!out)
+    return NULL;
+  memcpy(out, str, len);
+  out[len] = '\0';
+  return out;
+}
+
+jjson_t *jjson__pool_object(struct jjson__pool *pool)
+{
+  if (pool && pool->object_taken < pool->object_count)
+  {
+    return pool->objects[pool->object_taken++];
+  }
+  jjson_t *json = (jjson_t *)malloc(sizeof(jjson_t));
+  if (!json)
+    return NULL;
+  if (JJE_OK != jjson_init(json))
+  {
+    free(json);
+    return NULL;
+  }
+  json->pool = pool;
+  return json;
+}
+
+enum jjson_error jjson__pool_array(struct jjson__pool *pool, jjson_array *arr)
+{
+  if (pool && pool->array_taken < pool->array_count)
+  {
+    *arr = pool->arrays[pool->array_taken++];
+    return JJE_OK;
+  }
+  return jjson_init_array(arr);
+}
+
+/*
+ * Empties `json` in place and moves its descendants onto the free lists.
+ * Strings outside the arena are freed.
+ */
+void jjson__pool_recycle_object(struct jjson__pool *pool, jjson_t *json)
+{
+  for (size_t i = 0; i < json->field_count; ++i)
+  {
+    if (!(json->fields[i].value.in_arena & JJSON_IN_ARENA_KEY))
+      free((void *)json->fields[i].key);
+    jjson__pool_recycle_value(pool, &json->fields[i].value);
+  }
+  json->field_count = 0;
+  json->hash = 0;
+  json->pool = pool;
+}
+
+void jjson__pool_recycle_value(struct jjson__pool *pool, jjson_value *val)
+{
+  switch (val->type)
+  {
+  case JJSON_STRING:
+    if (!(val->in_arena & JJSON_IN_ARENA_STRING))
+      free(val->data.string);
+    break;
+  case JJSON_OBJECT:
+    // queued before its children, in the order the parser allocates them
+    if (pool->object_count == pool->object_capacity)
+    {
+      size_t new_cap = MAX(pool->object_capacity * 2, JSON_CAPACITY_INCR_RATE);
+      jjson_t **objects = (jjson_t **)realloc(pool->objects, sizeof(jjson_t *) * new_cap);
+      if (!objects)
+      {
+        jjson_deinit_value(val);
+        break;
+      }
+      pool->objects = objects;
+      pool->object_capacity = new_cap;
+    }
+    pool->objects[pool->object_count++] = val->data.object;
+    jjson__pool_recycle_object(pool, val->data.object);
+    break;
+  case JJSON_ARRAY:
+  {
+    jjson_array emptied = val->data.array;
+    emptied.length = 0;
+    if (pool->array_count == pool->array_capacity)
+    {
+      size_t new_cap = MAX(pool->array_capacity * 2, JSON_CAPACITY_INCR_RATE);
+      jjson_array *arrays = (jjson_array *)realloc(pool->arrays, sizeof(jjson_array) * new_cap);
+      if (!arrays)
+      {
+        jjson_deinit_array(&val->data.array);
+        break;
+      }
+      pool->arrays = arrays;
+      pool->array_capacity = new_cap;
+    }
+    pool->arrays[pool->array_count++] = emptied;
+    for (size_t i = 0; i < val->data.array.length; ++i)
+    {
+      jjson__pool_recycle_value(pool, &val->data.array.items[i]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void jjson__pool_rewind_arena(struct jjson__pool *pool)
+{
+  if (pool->chunks->next)
+  {
+    // the last document overflowed the first chunk: replace the chain with a
+    // single chunk big enough for all of it so the next one fits in one go
+    size_t total = 0;
+    jjson__pool_chunk *chunk = pool->chunks;
+    while (chunk)
+    {
+      jjson__pool_chunk *next = chunk->next;
+      total += chunk->size;
+      free(chunk);
+      chunk = next;
+    }
+    pool->chunks = jjson__pool_new_chunk(total);
+    if (!pool->chunks)
+      pool->chunks = jjson__pool_new_chunk(JJSON__POOL_CHUNK_SIZE);
+  }
+  pool->chunks->used = 0;
+  pool->current = pool->chunks;
+}
+
+/*
+ * Clears `json` for the next jjson_parse while keeping its memory: child
+ * objects, field and item buffers go to free lists and strings move to an
+ * arena owned by the document, so a loop parsing similarly-shaped content
+ * stops allocating after the first few iterations. Strings the caller passed
+ * to jjson_add or jjson_array_push are freed as they would be by jjson_deinit.
+ */
+enum jjson_error jjson_reset(jjson_t *json)
+{
+  if (!json->pool)
+  {
+    json->pool = jjson__pool_new();
+    if (!json->pool)
+      return JJE_ALLOC_FAIL;
+  }
+  struct jjson__pool *pool = json->pool;
+  // leftovers the last parse did not take stay at the front of the queues
+  if (pool->object_taken)
+  {
+    memmove(pool->objects, pool->objects + pool->object_taken, sizeof(jjson_t *) * (pool->object_count - pool->object_taken));
+    pool->object_count -= pool->object_taken;
+    pool->object_taken = 0;
+  }
+  if (pool->array_taken)
+  {
+    memmove(pool->arrays, pool->arrays + pool->array_taken, sizeof(jjson_array) * (pool->array_count - pool->array_taken));
+    pool->array_count -= pool->array_taken;
+    pool->array_taken = 0;
+  }
+  jjson__pool_recycle_object(pool, json);
+  jjson__pool_rewind_arena(json->pool);
+  return JJE_OK;
+}
+
 enum jjson_error jjson_init(jjson_t *json)
 {
   json->field_count = 0;
-  json->capacity = JSON_CAPACITY_INCR_RATE;
+  json->hash = 0;
+  json->parent = NULL;
+  json->pool = NULL;
   json->fields = (jjson_key_value *)malloc(sizeof(jjson_key_value) * JSON_CAPACITY_INCR_RATE);
+  // on failure `json` is still a valid empty object, safe to deinit
+  json->capacity = json->fields ? JSON_CAPACITY_INCR_RATE : 0;
+  if (!json->fields)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Out of memory initializing Json object");
+    return JJE_ALLOC_FAIL;
+  }
   return JJE_OK;
 }
 
@@ -226,6 +696,14 @@ enum jjson_error jjson_get_number(jjson_t *json, const char *key, long long **ou
 {
   jjson_value *value = NULL;
   enum jjson_error error = jjson_get(json, key, &value);
+  if (JJE_OK == error && JJSON_RAW_NUMBER == value->type)
+  {
+    long long tmp;
+    error = jjson_value_int64(value, &tmp);
+    if (JJE_OK == error)
+      *out = &value->data.raw_number.integer;
+    return error;
+  }
   if (JJE_OK != error || JJSON_NUMBER != value->type)
   {
     return error;
@@ -234,116 +712,917 @@ enum jjson_error jjson_get_number(jjson_t *json, const char *key, long long **ou
   return JJE_OK;
 }
 
-enum jjson_error jjson_add(jjson_t *json, jjson_key_value kv)
+enum jjson_error jjson_get_int64(jjson_t *json, const char *key, long long *out)
 {
-  if (json->capacity <= json->field_count)
-  {
-    size_t new_cap = json->capacity + JSON_CAPACITY_INCR_RATE;
-    json->fields = (jjson_key_value *)realloc(json->fields, sizeof(jjson_key_value) * new_cap);
-    json->capacity = new_cap;
-  }
-  json->fields[json->field_count++] = kv;
-  return JJE_OK;
+  jjson_value *value = NULL;
+  enum jjson_error error = jjson_get(json, key, &value);
+  if (JJE_OK != error)
+    return error;
+  return jjson_value_int64(value, out);
 }
 
-enum jjson_error jjson_add_string(jjson_t *json, const char *key, const char *value)
+enum jjson_error jjson_get_double(jjson_t *json, const char *key, double *out)
 {
-  jjson_key_value kv = {.key = strndup(key, JJSON__MAX_STR_LEN), .value.type = JJSON_STRING, .value.data.string = strndup(value, JJSON__MAX_STR_LEN)};
-  return jjson_add(json, kv);
+  jjson_value *value = NULL;
+  enum jjson_error error = jjson_get(json, key, &value);
+  if (JJE_OK != error)
+    return error;
+  return jjson_value_double(value, out);
 }
 
-enum jjson_error jjson_add_number(jjson_t *json, const char *key, long long value)
+enum jjson_error jjson_get_raw_number(jjson_t *json, const char *key, const char **text, size_t *length)
 {
-  jjson_key_value kv = {.key = strndup(key, JJSON__MAX_STR_LEN), .value.type = JJSON_NUMBER, .value.data.number = value};
-  return jjson_add(json, kv);
+  jjson_value *value = NULL;
+  enum jjson_error error = jjson_get(json, key, &value);
+  if (JJE_OK != error)
+    return error;
+  if (JJSON_RAW_NUMBER != value->type)
+    return JJE_TYPE_MISMATCH;
+  *text = value->data.raw_number.text;
+  *length = value->data.raw_number.length;
+  return JJE_OK;
 }
 
-/**
- * JSON Lexer
- */
-
-#define LEXER_EOF '\0'
-typedef int (*lexer_read_predicate)(int);
+#define JJSON__RAW_CACHED_INTEGER 1
+#define JJSON__RAW_CACHED_REAL 2
 
-void jjson__lexer_advance_one(jjson__lexer *l);
-void jjson__lexer_advance_while(jjson__lexer *l, lexer_read_predicate pred);
-void jjson__lexer_read_while(jjson__lexer *l, lexer_read_predicate pred, char **out);
-void jjson__lexer_skip_whitespace(jjson__lexer *l);
+enum jjson_error jjson__raw_to_int64(const char *text, size_t length, long long *out);
 
-void jjson__lexer_init(jjson__lexer *l, const char *content, size_t content_len)
+/*
+ * Parses a JSON integer literal. Literals with a fraction or exponent report
+ * JJE_TYPE_MISMATCH; integers that do not fit in 64 bits, like large IDs,
+ * report JJE_OUT_OF_RANGE and stay available verbatim through
+ * jjson_get_raw_number.
+ */
+enum jjson_error jjson__raw_to_int64(const char *text, size_t length, long long *out)
 {
-  l->content = content;
-  l->content_len = MIN(content_len, strnlen(content, JJSON__MAX_STR_LEN));
-  l->line = 1;
-  jjson__lexer_advance_one(l);
+  size_t i = 0;
+  int negative = 0;
+  if (i < length && text[i] == '-')
+  {
+    negative = 1;
+    i += 1;
+  }
+  if (i == length)
+    return JJE_TYPE_MISMATCH;
+  unsigned long long limit = negative ? (unsigned long long)LLONG_MAX + 1 : (unsigned long long)LLONG_MAX;
+  unsigned long long acc = 0;
+  for (; i < length; ++i)
+  {
+    if (!isdigit((unsigned char)text[i]))
+      return JJE_TYPE_MISMATCH;
+    unsigned digit = text[i] - '0';
+    if (acc > (limit - digit) / 10)
+      return JJE_OUT_OF_RANGE;
+    acc = acc * 10 + digit;
+  }
+  *out = negative ? (long long)(0 - acc) : (long long)acc;
+  return JJE_OK;
 }
 
-void jjson__lexer_advance_one(jjson__lexer *l)
+enum jjson_error jjson_value_int64(jjson_value *val, long long *out)
 {
-  if (l->read_pos >= l->content_len)
+  if (JJSON_NUMBER == val->type)
   {
-    l->curr_char = LEXER_EOF;
-    l->pos = l->read_pos;
-    return;
+    *out = val->data.number;
+    return JJE_OK;
   }
+  if (JJSON_RAW_NUMBER != val->type)
+    return JJE_TYPE_MISMATCH;
+  if (JJSON__RAW_CACHED_INTEGER != val->data.raw_number.cached)
+  {
+    long long integer;
+    enum jjson_error err = jjson__raw_to_int64(val->data.raw_number.text, val->data.raw_number.length, &integer);
+    if (JJE_OK != err)
+      return err;
+    // replaces a cached double, which jjson_value_double then derives from the integer
+    val->data.raw_number.integer = integer;
+    val->data.raw_number.cached = JJSON__RAW_CACHED_INTEGER;
+  }
+  *out = val->data.raw_number.integer;
+  return JJE_OK;
+}
 
-  l->curr_char = l->content[l->read_pos];
-  l->pos = l->read_pos;
-  l->read_pos += 1;
-
-  if (l->curr_char == '\n')
+enum jjson_error jjson_value_double(jjson_value *val, double *out)
+{
+  if (JJSON_NUMBER == val->type)
   {
-    l->line += 1;
-    l->colm = 0;
+    *out = (double)val->data.number;
+    return JJE_OK;
   }
-  else
+  if (JJSON_RAW_NUMBER != val->type)
+    return JJE_TYPE_MISMATCH;
+  if (JJSON__RAW_CACHED_INTEGER == val->data.raw_number.cached)
   {
-    l->colm += 1;
+    // kept as is: jjson_get_number may have handed out a pointer to it
+    *out = (double)val->data.raw_number.integer;
+    return JJE_OK;
+  }
+  if (JJSON__RAW_CACHED_REAL != val->data.raw_number.cached)
+  {
+    // the text is not NUL-terminated, strtod needs a copy
+    char small[64];
+    size_t length = val->data.raw_number.length;
+    char *buf = length < sizeof(small) ? small : (char *)malloc(length + 1);
+    if (!buf)
+      return JJE_ALLOC_FAIL;
+    memcpy(buf, val->data.raw_number.text, length);
+    buf[length] = '\0';
+    val->data.raw_number.real = strtod(buf, NULL);
+    val->data.raw_number.cached = JJSON__RAW_CACHED_REAL;
+    if (buf != small)
+      free(buf);
   }
+  *out = val->data.raw_number.real;
+  return JJE_OK;
 }
 
-void jjson__lexer_advance_while(jjson__lexer *l, lexer_read_predicate pred)
+enum jjson_error jjson__add_field(jjson_t *json, jjson_key_value kv);
+void jjson__adopt_value(jjson_t *parent, jjson_value *val);
+
+enum jjson_error jjson__add_member(jjson_t *json, jjson_key_value kv);
+
+enum jjson_error jjson_add(jjson_t *json, jjson_key_value kv)
 {
-  while (l->curr_char != LEXER_EOF && pred(l->curr_char))
+  // the caller malloc'd the key and strings, the document frees them
+  kv.value.in_arena = 0;
+  return jjson__add_member(json, kv);
+}
+
+// jjson_add keeping the arena bits of `kv`
+enum jjson_error jjson__add_member(jjson_t *json, jjson_key_value kv)
+{
+  jjson__adopt_value(json, &kv.value);
+  enum jjson_error err = jjson__add_field(json, kv);
+  jjson_invalidate_hash(json);
+  return err;
+}
+
+// Points the objects in `val`, directly or through arrays, at `parent`
+void jjson__adopt_value(jjson_t *parent, jjson_value *val)
+{
+  if (val->type == JJSON_OBJECT)
   {
-    jjson__lexer_advance_one(l);
+    val->data.object->parent = parent;
+  }
+  else if (val->type == JJSON_ARRAY)
+  {
+    for (size_t i = 0; i < val->data.array.length; ++i)
+    {
+      jjson__adopt_value(parent, &val->data.array.items[i]);
+    }
   }
 }
 
-void jjson__lexer_read_while(jjson__lexer *l, lexer_read_predicate pred, char **out)
+// jjson_add without touching parents or ancestors, for the parser
+enum jjson_error jjson__add_field(jjson_t *json, jjson_key_value kv)
 {
-  size_t start = l->pos;
-  while (l->curr_char != LEXER_EOF && pred(l->curr_char))
+  if (json->capacity <= json->field_count)
   {
-    jjson__lexer_advance_one(l);
+    size_t new_cap = json->capacity + JSON_CAPACITY_INCR_RATE;
+    json->fields = (jjson_key_value *)realloc(json->fields, sizeof(jjson_key_value) * new_cap);
+    json->capacity = new_cap;
   }
-  size_t buf_len = l->pos - start;
-  *out = (char *)malloc(sizeof(char) * (buf_len + 1));
-  strncpy(*out, l->content + start, buf_len);
-  (*out)[buf_len] = '\0';
+  json->fields[json->field_count++] = kv;
+  json->hash = 0;
+  return JJE_OK;
 }
 
-void jjson__lexer_skip_whitespace(jjson__lexer *l)
+enum jjson_error jjson_add_string(jjson_t *json, const char *key, const char *value)
 {
-  jjson__lexer_advance_while(l, isspace);
+  jjson_key_value kv;
+  kv.key = jjson__pool_strdup(json->pool, key);
+  kv.value.type = JJSON_STRING;
+  kv.value.in_arena = json->pool ? JJSON_IN_ARENA_KEY | JJSON_IN_ARENA_STRING : 0;
+  kv.value.data.string = jjson__pool_strdup(json->pool, value);
+  return jjson__add_member(json, kv);
 }
 
-int jjson__lexer_is_not_unquote(int c) { return c != '"'; }
-
-void jjson__lexer_next_token(jjson__lexer *l, jjson__token *token)
+enum jjson_error jjson_add_number(jjson_t *json, const char *key, long long value)
 {
-  jjson__lexer_skip_whitespace(l);
+  jjson_key_value kv;
+  kv.key = jjson__pool_strdup(json->pool, key);
+  kv.value.type = JJSON_NUMBER;
+  kv.value.in_arena = json->pool ? JJSON_IN_ARENA_KEY : 0;
+  kv.value.data.number = value;
+  return jjson__add_member(json, kv);
+}
 
-  token->pos.line = l->line;
-  token->pos.colm = l->colm;
+/**
+ * JSON String Scanning
+ */
 
-  if (l->curr_char == LEXER_EOF)
+#define JJSON__STR_ESCAPED 0x1
+#define JJSON__STR_NON_ASCII 0x2
+
+size_t jjson__scan_string_special(const char *s, size_t i, size_t len, unsigned *flags);
+enum jjson_error jjson__scan_string(const char *s, size_t start, size_t len, size_t *end, unsigned *flags);
+size_t jjson__decode_escape(const char *s, size_t i, size_t len, char *out, size_t *out_len);
+size_t jjson__decode_string(const char *s, size_t start, size_t end, char *out);
+size_t jjson__validate_utf8(const char *s, size_t len);
+size_t jjson__validate_utf8_scalar(const char *s, size_t len);
+size_t jjson__validate_utf8_resume(const char *s, size_t len, size_t block);
+#if defined(JJSON__SSSE3)
+size_t jjson__validate_utf8_ssse3(const char *s, size_t len);
+#endif
+#if defined(JJSON__AVX2)
+size_t jjson__validate_utf8_avx2(const char *s, size_t len);
+#endif
+
+/*
+ * Returns the index of the first byte in `s[i..len)` that ends a clean run
+ * inside a string (`"`, `\` or a control character), or `len` when there is
+ * none. Sets JJSON__STR_NON_ASCII in `flags` when the skipped run has bytes
+ * >= 0x80, so the caller knows whether UTF-8 validation is needed.
+ */
+size_t jjson__scan_string_special(const char *s, size_t i, size_t len, unsigned *flags)
+{
+#if defined(JJSON__AVX2)
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i bslash32 = _mm256_set1_epi8('\\');
+  const __m256i ctrl32 = _mm256_set1_epi8(0x1F);
+  for (; i + 32 <= len; i += 32)
   {
-    token->type = JJSON__TOKEN_EOF;
-    return;
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, bslash32)),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, ctrl32), ctrl32));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+    unsigned high = (unsigned)_mm256_movemask_epi8(chunk);
+    if (mask)
+    {
+      unsigned offset = __builtin_ctz(mask);
+      if (high & ((1u << offset) - 1))
+        *flags |= JJSON__STR_NON_ASCII;
+      return i + offset;
+    }
+    if (high)
+      *flags |= JJSON__STR_NON_ASCII;
   }
-
-  switch (l->curr_char)
+#endif
+#if defined(JJSON__SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i ctrl = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, bslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, ctrl), ctrl));
+    unsigned mask = (unsigned)_mm_movemask_epi8(special);
+    unsigned high = (unsigned)_mm_movemask_epi8(chunk);
+    if (mask)
+    {
+      unsigned offset = __builtin_ctz(mask);
+      if (high & ((1u << offset) - 1))
+        *flags |= JJSON__STR_NON_ASCII;
+      return i + offset;
+    }
+    if (high)
+      *flags |= JJSON__STR_NON_ASCII;
+  }
+#endif
+  for (; i < len; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\' || c < 0x20)
+      return i;
+    if (c >= 0x80)
+      *flags |= JJSON__STR_NON_ASCII;
+  }
+  return len;
+}
+
+/*
+ * Finds the closing quote of the string whose first content byte is
+ * `s[start]`. On success `*end` is the index of the closing quote. On failure
+ * `*end` is the offset of the offending byte and an error message is set.
+ */
+enum jjson_error jjson__scan_string(const char *s, size_t start, size_t len, size_t *end, unsigned *flags)
+{
+  size_t i = start;
+  while (1)
+  {
+    i = jjson__scan_string_special(s, i, len, flags);
+    if (i >= len)
+    {
+      *end = i;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unterminated string");
+      return JJE_INVALID_TKN;
+    }
+    if (s[i] == '"')
+    {
+      break;
+    }
+    if (s[i] != '\\')
+    {
+      *end = i;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unescaped control character 0x%02x in string", (unsigned char)s[i]);
+      return JJE_INVALID_TKN;
+    }
+    size_t consumed = jjson__decode_escape(s, i, len, NULL, NULL);
+    if (consumed == 0)
+    {
+      *end = i;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Invalid escape sequence in string");
+      return JJE_INVALID_TKN;
+    }
+    *flags |= JJSON__STR_ESCAPED;
+    i += consumed;
+  }
+  *end = i;
+  if (*flags & JJSON__STR_NON_ASCII)
+  {
+    size_t bad = jjson__validate_utf8(s + start, i - start);
+    if (bad != i - start)
+    {
+      *end = start + bad;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Invalid UTF-8 in string");
+      return JJE_INVALID_TKN;
+    }
+  }
+  return JJE_OK;
+}
+
+int jjson__hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+long jjson__read_hex4(const char *s, size_t i, size_t len)
+{
+  if (i + 4 > len)
+    return -1;
+  long cp = 0;
+  for (size_t k = i; k < i + 4; ++k)
+  {
+    int digit = jjson__hex_value(s[k]);
+    if (digit < 0)
+      return -1;
+    cp = (cp << 4) | digit;
+  }
+  return cp;
+}
+
+size_t jjson__encode_utf8(unsigned long cp, char *out)
+{
+  if (cp < 0x80)
+  {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+/*
+ * Decodes the escape sequence at `s[i] == '\\'`, including UTF-16 surrogate
+ * pairs. Writes the UTF-8 bytes to `out` unless it is NULL. Returns the number
+ * of input bytes consumed, or 0 when the sequence is malformed.
+ */
+size_t jjson__decode_escape(const char *s, size_t i, size_t len, char *out, size_t *out_len)
+{
+  if (i + 1 >= len)
+    return 0;
+  char decoded;
+  switch (s[i + 1])
+  {
+  case '"':
+    decoded = '"';
+    break;
+  case '\\':
+    decoded = '\\';
+    break;
+  case '/':
+    decoded = '/';
+    break;
+  case 'b':
+    decoded = '\b';
+    break;
+  case 'f':
+    decoded = '\f';
+    break;
+  case 'n':
+    decoded = '\n';
+    break;
+  case 'r':
+    decoded = '\r';
+    break;
+  case 't':
+    decoded = '\t';
+    break;
+  case 'u':
+  {
+    long cp = jjson__read_hex4(s, i + 2, len);
+    size_t consumed = 6;
+    if (cp < 0 || (cp >= 0xDC00 && cp <= 0xDFFF))
+      return 0;
+    if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+      if (i + 7 >= len || s[i + 6] != '\\' || s[i + 7] != 'u')
+        return 0;
+      long low = jjson__read_hex4(s, i + 8, len);
+      if (low < 0xDC00 || low > 0xDFFF)
+        return 0;
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+      consumed = 12;
+    }
+    if (out)
+      *out_len = jjson__encode_utf8((unsigned long)cp, out);
+    return consumed;
+  }
+  default:
+    return 0;
+  }
+  if (out)
+  {
+    out[0] = decoded;
+    *out_len = 1;
+  }
+  return 2;
+}
+
+/*
+ * Decodes the already scanned string `s[start..end)` into `out`, copying
+ * escape-free runs in bulk. `out` needs room for `end - start` bytes since
+ * every escape decodes to fewer bytes than it occupies. Returns the decoded
+ * length.
+ */
+size_t jjson__decode_string(const char *s, size_t start, size_t end, char *out)
+{
+  size_t written = 0;
+  size_t i = start;
+  unsigned flags = 0;
+  while (i < end)
+  {
+    size_t special = jjson__scan_string_special(s, i, end, &flags);
+    memcpy(out + written, s + i, special - i);
+    written += special - i;
+    if (special >= end)
+      break;
+    size_t out_len = 0;
+    i = special + jjson__decode_escape(s, special, end, out + written, &out_len);
+    written += out_len;
+  }
+  return written;
+}
+
+/*
+ * Decodes the contents of a string that jjson_validate or jjson_scan accepted,
+ * without its quotes, into `out`, which needs room for `len` bytes. Returns
+ * the decoded length.
+ */
+size_t jjson_unescape(const char *s, size_t len, char *out)
+{
+  return jjson__decode_string(s, 0, len, out);
+}
+
+/*
+ * Returns `len` when `s` is well-formed UTF-8, otherwise the offset of the
+ * first byte of the offending sequence. Uses the SIMD lookup validators when
+ * available and the scalar one to pin down the offset.
+ */
+size_t jjson__validate_utf8(const char *s, size_t len)
+{
+#if defined(JJSON__AVX2)
+  return jjson__validate_utf8_avx2(s, len);
+#elif defined(JJSON__SSSE3)
+  return jjson__validate_utf8_ssse3(s, len);
+#else
+  return jjson__validate_utf8_scalar(s, len);
+#endif
+}
+
+// Scalar validation resumed near `block`, where a vector check found a problem
+size_t jjson__validate_utf8_resume(const char *s, size_t len, size_t block)
+{
+  size_t i = 0;
+  if (block > 0)
+  {
+    // the sequence at fault starts at most 3 bytes before the block; bytes
+    // before `block` already passed, so continuation bytes there are valid
+    i = block - 3;
+    while (i < block && ((unsigned char)s[i] & 0xC0) == 0x80)
+      i += 1;
+  }
+  return i + jjson__validate_utf8_scalar(s + i, len - i);
+}
+
+/*
+ * Lookup-table validation (Keiser & Lemire): every byte is classified by its
+ * high nibble, the previous byte's nibbles and the distance to the last lead
+ * byte, and any impossible combination sets a bit in the error vector.
+ */
+#define JJSON__UTF8_TOO_SHORT (1 << 0)
+#define JJSON__UTF8_TOO_LONG (1 << 1)
+#define JJSON__UTF8_OVERLONG_3 (1 << 2)
+#define JJSON__UTF8_TOO_LARGE (1 << 3)
+#define JJSON__UTF8_SURROGATE (1 << 4)
+#define JJSON__UTF8_OVERLONG_2 (1 << 5)
+#define JJSON__UTF8_TOO_LARGE_1000 (1 << 6)
+#define JJSON__UTF8_OVERLONG_4 (1 << 6)
+#define JJSON__UTF8_TWO_CONTS (1 << 7)
+#define JJSON__UTF8_CARRY (JJSON__UTF8_TOO_SHORT | JJSON__UTF8_TOO_LONG | JJSON__UTF8_TWO_CONTS)
+
+// indexed by the high nibble of the previous byte
+#define JJSON__UTF8_BYTE_1_HIGH                                                                                   \
+  JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG,                          \
+      JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG, JJSON__UTF8_TOO_LONG,                      \
+      JJSON__UTF8_TWO_CONTS, JJSON__UTF8_TWO_CONTS, JJSON__UTF8_TWO_CONTS, JJSON__UTF8_TWO_CONTS,                  \
+      JJSON__UTF8_TOO_SHORT | JJSON__UTF8_OVERLONG_2, JJSON__UTF8_TOO_SHORT,                                       \
+      JJSON__UTF8_TOO_SHORT | JJSON__UTF8_OVERLONG_3 | JJSON__UTF8_SURROGATE,                                      \
+      (char)(JJSON__UTF8_TOO_SHORT | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000 | JJSON__UTF8_OVERLONG_4)
+
+// indexed by the low nibble of the previous byte
+#define JJSON__UTF8_BYTE_1_LOW                                                                                    \
+  (char)(JJSON__UTF8_CARRY | JJSON__UTF8_OVERLONG_3 | JJSON__UTF8_OVERLONG_2 | JJSON__UTF8_OVERLONG_4),            \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_OVERLONG_2), (char)JJSON__UTF8_CARRY, (char)JJSON__UTF8_CARRY,        \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE),                                                           \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000 | JJSON__UTF8_SURROGATE),      \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000),                              \
+      (char)(JJSON__UTF8_CARRY | JJSON__UTF8_TOO_LARGE | JJSON__UTF8_TOO_LARGE_1000)
+
+// indexed by the high nibble of the current byte
+#define JJSON__UTF8_BYTE_2_HIGH                                                                                   \
+  JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT,                      \
+      JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT,                  \
+      (char)(JJSON__UTF8_TOO_LONG | JJSON__UTF8_OVERLONG_2 | JJSON__UTF8_TWO_CONTS | JJSON__UTF8_OVERLONG_3 |      \
+             JJSON__UTF8_TOO_LARGE_1000 | JJSON__UTF8_OVERLONG_4),                                                 \
+      (char)(JJSON__UTF8_TOO_LONG | JJSON__UTF8_OVERLONG_2 | JJSON__UTF8_TWO_CONTS | JJSON__UTF8_OVERLONG_3 |      \
+             JJSON__UTF8_TOO_LARGE),                                                                               \
+      (char)(JJSON__UTF8_TOO_LONG | JJSON__UTF8_OVERLONG_2 | JJSON__UTF8_TWO_CONTS | JJSON__UTF8_SURROGATE |       \
+             JJSON__UTF8_TOO_LARGE),                                                                               \
+      (char)(JJSON__UTF8_TOO_LONG | JJSON__UTF8_OVERLONG_2 | JJSON__UTF8_TWO_CONTS | JJSON__UTF8_SURROGATE |       \
+             JJSON__UTF8_TOO_LARGE),                                                                               \
+      JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT, JJSON__UTF8_TOO_SHORT
+
+#if defined(JJSON__SSSE3)
+size_t jjson__validate_utf8_ssse3(const char *s, size_t len)
+{
+  const __m128i byte_1_high = _mm_setr_epi8(JJSON__UTF8_BYTE_1_HIGH);
+  const __m128i byte_1_low = _mm_setr_epi8(JJSON__UTF8_BYTE_1_LOW);
+  const __m128i byte_2_high = _mm_setr_epi8(JJSON__UTF8_BYTE_2_HIGH);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i zero = _mm_setzero_si128();
+  // a lead byte in the last 1, 2 or 3 positions still needs continuation bytes
+  const __m128i max_complete = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+  __m128i prev_input = zero;
+  __m128i prev_incomplete = zero;
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i input = _mm_loadu_si128((const __m128i *)(s + i));
+    if (_mm_movemask_epi8(input) == 0)
+    {
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(prev_incomplete, zero)) != 0xFFFF)
+        return jjson__validate_utf8_resume(s, len, i);
+      prev_input = input;
+      continue;
+    }
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                      _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i must_23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)), _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80)));
+    __m128i error = _mm_xor_si128(_mm_and_si128(must_23, _mm_set1_epi8((char)0x80)), special);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xFFFF)
+      return jjson__validate_utf8_resume(s, len, i);
+    prev_incomplete = _mm_subs_epu8(input, max_complete);
+    prev_input = input;
+  }
+  // the tail, including a sequence cut by the last block, is left to the scalar path
+  return jjson__validate_utf8_resume(s, len, i);
+}
+#endif
+
+#if defined(JJSON__AVX2)
+size_t jjson__validate_utf8_avx2(const char *s, size_t len)
+{
+  const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(JJSON__UTF8_BYTE_1_HIGH));
+  const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_setr_epi8(JJSON__UTF8_BYTE_1_LOW));
+  const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(JJSON__UTF8_BYTE_2_HIGH));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i max_complete = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+  __m256i prev_input = _mm256_setzero_si256();
+  __m256i prev_incomplete = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32)
+  {
+    __m256i input = _mm256_loadu_si256((const __m256i *)(s + i));
+    if (_mm256_movemask_epi8(input) == 0)
+    {
+      if (!_mm256_testz_si256(prev_incomplete, prev_incomplete))
+        return jjson__validate_utf8_resume(s, len, i);
+      prev_input = input;
+      continue;
+    }
+    // the upper half of the previous block followed by the lower half of this one
+    __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                         _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+    __m256i must_23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)), _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80)));
+    __m256i error = _mm256_xor_si256(_mm256_and_si256(must_23, _mm256_set1_epi8((char)0x80)), special);
+    if (!_mm256_testz_si256(error, error))
+      return jjson__validate_utf8_resume(s, len, i);
+    prev_incomplete = _mm256_subs_epu8(input, max_complete);
+    prev_input = input;
+  }
+  return jjson__validate_utf8_resume(s, len, i);
+}
+#endif
+
+/*
+ * Byte-at-a-time validation, with ASCII skipped a vector at a time. Returns
+ * the offset of the first byte of the offending sequence, or `len`.
+ */
+size_t jjson__validate_utf8_scalar(const char *s, size_t len)
+{
+  const unsigned char *u = (const unsigned char *)s;
+  size_t i = 0;
+  while (i < len)
+  {
+#if defined(JJSON__SSE2)
+    while (i + 16 <= len && _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(u + i))) == 0)
+    {
+      i += 16;
+    }
+    if (i >= len)
+      break;
+#endif
+    unsigned char c = u[i];
+    if (c < 0x80)
+    {
+      i += 1;
+      continue;
+    }
+    size_t need;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+      need = 1;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      need = 2;
+      if (c == 0xE0)
+        lo = 0xA0;
+      else if (c == 0xED)
+        hi = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      need = 3;
+      if (c == 0xF0)
+        lo = 0x90;
+      else if (c == 0xF4)
+        hi = 0x8F;
+    }
+    else
+    {
+      return i;
+    }
+    if (i + need >= len)
+      return i;
+    if (u[i + 1] < lo || u[i + 1] > hi)
+      return i;
+    for (size_t k = 2; k <= need; ++k)
+    {
+      if ((u[i + k] & 0xC0) != 0x80)
+        return i;
+    }
+    i += need + 1;
+  }
+  return len;
+}
+
+/**
+ * JSON Lexer
+ */
+
+#define LEXER_EOF '\0'
+typedef int (*lexer_read_predicate)(int);
+
+void jjson__lexer_advance_one(jjson__lexer *l);
+void jjson__lexer_advance_while(jjson__lexer *l, lexer_read_predicate pred);
+void jjson__lexer_read_while(jjson__lexer *l, lexer_read_predicate pred, char **out);
+void jjson__lexer_skip_whitespace(jjson__lexer *l);
+void jjson__lexer_jump(jjson__lexer *l, size_t pos);
+void jjson__lexer_read_raw_number(jjson__lexer *l, jjson__token *token);
+enum jjson_error jjson__lexer_read_string(jjson__lexer *l, char **out);
+
+void jjson__lexer_init(jjson__lexer *l, const char *content, size_t content_len)
+{
+  l->content = content;
+  const char *nul = (const char *)memchr(content, '\0', content_len);
+  l->content_len = nul ? (size_t)(nul - content) : content_len;
+  l->line = 1;
+  jjson__lexer_advance_one(l);
+}
+
+void jjson__lexer_advance_one(jjson__lexer *l)
+{
+  if (l->read_pos >= l->content_len)
+  {
+    l->curr_char = LEXER_EOF;
+    l->pos = l->read_pos;
+    return;
+  }
+
+  l->curr_char = l->content[l->read_pos];
+  l->pos = l->read_pos;
+  l->read_pos += 1;
+
+  if (l->curr_char == '\n')
+  {
+    l->line += 1;
+    l->colm = 0;
+  }
+  else
+  {
+    l->colm += 1;
+  }
+}
+
+void jjson__lexer_advance_while(jjson__lexer *l, lexer_read_predicate pred)
+{
+  while (l->curr_char != LEXER_EOF && pred(l->curr_char))
+  {
+    jjson__lexer_advance_one(l);
+  }
+}
+
+void jjson__lexer_read_while(jjson__lexer *l, lexer_read_predicate pred, char **out)
+{
+  size_t start = l->pos;
+  while (l->curr_char != LEXER_EOF && pred(l->curr_char))
+  {
+    jjson__lexer_advance_one(l);
+  }
+  size_t buf_len = l->pos - start;
+  *out = (char *)malloc(sizeof(char) * (buf_len + 1));
+  strncpy(*out, l->content + start, buf_len);
+  (*out)[buf_len] = '\0';
+}
+
+void jjson__lexer_skip_whitespace(jjson__lexer *l)
+{
+  jjson__lexer_advance_while(l, isspace);
+}
+
+/*
+ * Scans a number per the JSON grammar without converting it, leaving the token
+ * pointing at its text in the content buffer.
+ */
+void jjson__lexer_read_raw_number(jjson__lexer *l, jjson__token *token)
+{
+  const char *s = l->content;
+  size_t len = l->content_len;
+  size_t start = l->pos;
+  size_t i = start;
+  int valid = 1;
+  if (s[i] == '-')
+    i += 1;
+  if (s[i] == '0')
+  {
+    i += 1;
+  }
+  else
+  {
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  if (i < len && s[i] == '.')
+  {
+    i += 1;
+    valid = i < len && isdigit((unsigned char)s[i]);
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  if (valid && i < len && (s[i] == 'e' || s[i] == 'E'))
+  {
+    i += 1;
+    if (i < len && (s[i] == '+' || s[i] == '-'))
+      i += 1;
+    valid = i < len && isdigit((unsigned char)s[i]);
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  if (!valid)
+  {
+    token->type = JJSON__TOKEN_INVALID;
+    token->label.chr = i < len ? s[i] : LEXER_EOF;
+    jjson__lexer_jump(l, i);
+    return;
+  }
+  token->type = JJSON__TOKEN_NUMBER;
+  token->label.raw.text = s + start;
+  token->label.raw.length = i - start;
+  jjson__lexer_jump(l, i);
+}
+
+void jjson__lexer_jump(jjson__lexer *l, size_t pos)
+{
+  // Bulk scanners never skip over a newline, so the column moves in one step
+  l->colm += pos - l->read_pos;
+  l->read_pos = pos;
+  jjson__lexer_advance_one(l);
+}
+
+enum jjson_error jjson__lexer_read_string(jjson__lexer *l, char **out)
+{
+  size_t start = l->pos + 1;
+  size_t end = start;
+  unsigned flags = 0;
+  enum jjson_error err = jjson__scan_string(l->content, start, l->content_len, &end, &flags);
+  if (JJE_OK != err)
+  {
+    size_t msg_len = strlen(jjson__last_error_message);
+    snprintf(jjson__last_error_message + msg_len, JJSON__ERROR_MSG_MAX_LEN - msg_len, " at %lu:%lu", l->line, l->colm + (end - l->pos));
+    return err;
+  }
+  *out = jjson__pool_alloc_string(l->pool, sizeof(char) * (end - start + 1));
+  if (!*out)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Out of memory reading string at %lu:%lu", l->line, l->colm);
+    return JJE_ALLOC_FAIL;
+  }
+  size_t out_len = end - start;
+  if (flags & JJSON__STR_ESCAPED)
+  {
+    out_len = jjson__decode_string(l->content, start, end, *out);
+    // strings are NUL-terminated, a decoded \u0000 would silently cut them short
+    if (memchr(*out, '\0', out_len))
+    {
+      if (!l->pool)
+        free(*out);
+      *out = NULL;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: \\u0000 is not supported in strings at %lu:%lu", l->line, l->colm);
+      return JJE_INVALID_TKN;
+    }
+  }
+  else
+  {
+    memcpy(*out, l->content + start, out_len);
+  }
+  (*out)[out_len] = '\0';
+  jjson__lexer_jump(l, end + 1);
+  return JJE_OK;
+}
+
+void jjson__lexer_next_token(jjson__lexer *l, jjson__token *token)
+{
+  jjson__lexer_skip_whitespace(l);
+
+  token->pos.line = l->line;
+  token->pos.colm = l->colm;
+
+  if (l->curr_char == LEXER_EOF)
+  {
+    token->type = JJSON__TOKEN_EOF;
+    return;
+  }
+
+  switch (l->curr_char)
   {
   case '{':
     jjson__lexer_advance_one(l);
@@ -370,465 +1649,2510 @@ void jjson__lexer_next_token(jjson__lexer *l, jjson__token *token)
     token->type = JJSON__TOKEN_COMMA;
     return;
   case '"':
-    jjson__lexer_advance_one(l);
+    if (JJE_OK != jjson__lexer_read_string(l, &(token->label.string)))
+    {
+      token->type = JJSON__TOKEN_BAD_STRING;
+      return;
+    }
     token->type = JJSON__TOKEN_STRING;
-    jjson__lexer_read_while(l, jjson__lexer_is_not_unquote, &(token->label.string));
-    jjson__lexer_advance_one(l);
     return;
   }
 
   if (isalpha(l->curr_char))
   {
-    char *buf;
-    jjson__lexer_read_while(l, isalpha, &buf);
+    const char *word = l->content + l->pos;
+    size_t start = l->pos;
+    jjson__lexer_advance_while(l, isalpha);
+    size_t word_len = l->pos - start;
 
-    if (strcmp(buf, "null") == 0)
+    if (word_len == 4 && memcmp(word, "null", 4) == 0)
     {
       token->type = JJSON__TOKEN_NULL;
     }
-    else if (strcmp(buf, "true") == 0)
+    else if (word_len == 4 && memcmp(word, "true", 4) == 0)
     {
       token->type = JJSON__TOKEN_TRUE;
     }
-    else if (strcmp(buf, "false") == 0)
+    else if (word_len == 5 && memcmp(word, "false", 5) == 0)
+    {
+      token->type = JJSON__TOKEN_FALSE;
+    }
+    else
+    {
+      token->type = JJSON__TOKEN_INVALID;
+      token->label.chr = word[0];
+    }
+    return;
+  }
+
+  // parsing `+69` as `69`
+  if (l->curr_char == '+' && l->read_pos < l->content_len && isdigit(l->content[l->read_pos]))
+  {
+    jjson__lexer_advance_one(l);
+  }
+
+  if (isdigit(l->curr_char) ||
+      ((l->curr_char == '-') && ((l->content_len > l->read_pos) && isdigit(l->content[l->read_pos]))))
+  {
+    if (l->raw_numbers)
+    {
+      jjson__lexer_read_raw_number(l, token);
+      return;
+    }
+
+    int is_signed = 0;
+    if (l->curr_char == '-')
+    {
+      jjson__lexer_advance_one(l);
+      is_signed = 1;
+    }
+
+    // convert in place, saturating like strtol did
+    unsigned long acc = 0;
+    while (l->curr_char != LEXER_EOF && isdigit(l->curr_char))
+    {
+      unsigned digit = l->curr_char - '0';
+      acc = acc > (unsigned long)(LONG_MAX - digit) / 10 ? (unsigned long)LONG_MAX : acc * 10 + digit;
+      jjson__lexer_advance_one(l);
+    }
+    token->type = JJSON__TOKEN_NUMBER;
+    token->label.number = (long)acc;
+
+    if (is_signed)
+    {
+      token->label.number = -token->label.number;
+    }
+    return;
+  }
+
+  token->type = JJSON__TOKEN_INVALID;
+  token->label.chr = l->curr_char;
+  jjson__lexer_advance_one(l);
+  return;
+}
+
+/**
+ * JSON Hashing
+ */
+
+#define JJSON__HASH_PRIME 0x9E3779B97F4A7C15ULL
+#define JJSON__HASH_ARRAY 0xA5A5A5A5A5A5A5A5ULL
+#define JJSON__HASH_OBJECT 0x5A5A5A5A5A5A5A5AULL
+
+unsigned long long jjson__hash_mix(unsigned long long h);
+unsigned long long jjson__hash_bytes(const char *s, size_t len, unsigned long long seed);
+unsigned long long jjson__hash_value(const jjson_value *val);
+unsigned long long jjson__hash_field(const char *key, unsigned long long value_hash);
+unsigned long long jjson__hash_finish_array(unsigned long long items_hash, size_t length);
+unsigned long long jjson__hash_finish_object(unsigned long long fields_hash, size_t field_count);
+jjson_bool jjson__value_equal(const jjson_value *a, const jjson_value *b);
+jjson_bool jjson__number_equal(const jjson_value *a, const jjson_value *b);
+int jjson__number_as_int64(const jjson_value *val, long long *out);
+
+// splitmix64 finalizer
+unsigned long long jjson__hash_mix(unsigned long long h)
+{
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return h;
+}
+
+unsigned long long jjson__hash_bytes(const char *s, size_t len, unsigned long long seed)
+{
+  unsigned long long h = seed ^ (len * JJSON__HASH_PRIME);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    unsigned long long word;
+    memcpy(&word, s + i, 8);
+    h = (h ^ jjson__hash_mix(word)) * JJSON__HASH_PRIME;
+  }
+  unsigned long long tail = 0;
+  memcpy(&tail, s + i, len - i);
+  return jjson__hash_mix(h ^ tail);
+}
+
+unsigned long long jjson__hash_value(const jjson_value *val)
+{
+  switch (val->type)
+  {
+  case JJSON_STRING:
+    return jjson__hash_bytes(val->data.string, strlen(val->data.string), JJSON_STRING);
+  case JJSON_NUMBER:
+    return jjson__hash_mix((unsigned long long)val->data.number ^ (JJSON_NUMBER * JJSON__HASH_PRIME));
+  case JJSON_RAW_NUMBER:
+  {
+    // integers hash like JJSON_NUMBER so both parse modes agree
+    long long integer;
+    if (JJE_OK == jjson__raw_to_int64(val->data.raw_number.text, val->data.raw_number.length, &integer))
+      return jjson__hash_mix((unsigned long long)integer ^ (JJSON_NUMBER * JJSON__HASH_PRIME));
+    return jjson__hash_bytes(val->data.raw_number.text, val->data.raw_number.length, JJSON_RAW_NUMBER);
+  }
+  case JJSON_ARRAY:
+  {
+    unsigned long long h = JJSON__HASH_ARRAY;
+    for (size_t i = 0; i < val->data.array.length; ++i)
+    {
+      h = jjson__hash_mix(h ^ jjson__hash_value(&val->data.array.items[i]));
+    }
+    return jjson__hash_finish_array(h, val->data.array.length);
+  }
+  case JJSON_OBJECT:
+    return jjson_hash(val->data.object);
+  case JJSON_BOOLEAN:
+    return jjson__hash_mix((JJSON_BOOLEAN + val->data.boolean) * JJSON__HASH_PRIME);
+  default:
+    return jjson__hash_mix(val->type * JJSON__HASH_PRIME);
+  }
+}
+
+// fields are summed so the hash does not depend on their order
+unsigned long long jjson__hash_field(const char *key, unsigned long long value_hash)
+{
+  return jjson__hash_mix(jjson__hash_bytes(key, strlen(key), JJSON__HASH_OBJECT) ^ (value_hash * JJSON__HASH_PRIME));
+}
+
+unsigned long long jjson__hash_finish_array(unsigned long long items_hash, size_t length)
+{
+  return jjson__hash_mix(items_hash ^ length);
+}
+
+unsigned long long jjson__hash_finish_object(unsigned long long fields_hash, size_t field_count)
+{
+  unsigned long long h = jjson__hash_mix(fields_hash ^ JJSON__HASH_OBJECT ^ (field_count * JJSON__HASH_PRIME));
+  // 0 marks an unknown hash in jjson_t
+  return h ? h : 1;
+}
+
+/*
+ * Drops the cached hash of `json` and of every object above it. jjson_add
+ * does this itself; call it after editing a document in place, e.g. after
+ * jjson_array_push into an array held by `json`, since arrays do not know
+ * which object holds them.
+ */
+void jjson_invalidate_hash(jjson_t *json)
+{
+  for (; json; json = json->parent)
+  {
+    json->hash = 0;
+  }
+}
+
+unsigned long long jjson_hash(const jjson_t *json)
+{
+  if (json->hash)
+  {
+    return json->hash;
+  }
+  unsigned long long fields_hash = 0;
+  for (size_t i = 0; i < json->field_count; ++i)
+  {
+    fields_hash += jjson__hash_field(json->fields[i].key, jjson__hash_value(&json->fields[i].value));
+  }
+  return jjson__hash_finish_object(fields_hash, json->field_count);
+}
+
+jjson_bool jjson_equal(const jjson_t *a, const jjson_t *b)
+{
+  if (a == b)
+  {
+    return JJSON_TRUE;
+  }
+  if (a->field_count != b->field_count)
+  {
+    return JJSON_FALSE;
+  }
+  if (a->hash && b->hash && a->hash != b->hash)
+  {
+    return JJSON_FALSE;
+  }
+  // each field of `b` may match only once, so repeated keys compare as a multiset
+  unsigned char small[64] = {0};
+  unsigned char *matched = small;
+  if (b->field_count > sizeof(small) * 8)
+  {
+    matched = (unsigned char *)calloc((b->field_count + 7) / 8, 1);
+    if (!matched)
+      return JJSON_FALSE;
+  }
+  jjson_bool equal = JJSON_TRUE;
+  for (size_t i = 0; equal && i < a->field_count; ++i)
+  {
+    const jjson_key_value *kv = &a->fields[i];
+    equal = JJSON_FALSE;
+    for (size_t j = 0; j < b->field_count; ++j)
+    {
+      if (matched[j / 8] & (1u << (j % 8)))
+        continue;
+      if (strcmp(kv->key, b->fields[j].key) == 0 && jjson__value_equal(&kv->value, &b->fields[j].value))
+      {
+        matched[j / 8] |= (unsigned char)(1u << (j % 8));
+        equal = JJSON_TRUE;
+        break;
+      }
+    }
+  }
+  if (matched != small)
+    free(matched);
+  return equal;
+}
+
+jjson_bool jjson__value_equal(const jjson_value *a, const jjson_value *b)
+{
+  if (a->type == JJSON_RAW_NUMBER || b->type == JJSON_RAW_NUMBER)
+  {
+    return jjson__number_equal(a, b);
+  }
+  if (a->type != b->type)
+  {
+    return JJSON_FALSE;
+  }
+  switch (a->type)
+  {
+  case JJSON_STRING:
+    return strcmp(a->data.string, b->data.string) == 0 ? JJSON_TRUE : JJSON_FALSE;
+  case JJSON_NUMBER:
+    return a->data.number == b->data.number ? JJSON_TRUE : JJSON_FALSE;
+  case JJSON_BOOLEAN:
+    return a->data.boolean == b->data.boolean ? JJSON_TRUE : JJSON_FALSE;
+  case JJSON_ARRAY:
+    if (a->data.array.length != b->data.array.length)
+    {
+      return JJSON_FALSE;
+    }
+    for (size_t i = 0; i < a->data.array.length; ++i)
+    {
+      if (!jjson__value_equal(&a->data.array.items[i], &b->data.array.items[i]))
+      {
+        return JJSON_FALSE;
+      }
+    }
+    return JJSON_TRUE;
+  case JJSON_OBJECT:
+    return jjson_equal(a->data.object, b->data.object);
+  default:
+    return JJSON_TRUE;
+  }
+}
+
+// Returns 1 when `val` is an integer that fits in 64 bits, 0 for other numbers and -1 for non-numbers
+int jjson__number_as_int64(const jjson_value *val, long long *out)
+{
+  switch (val->type)
+  {
+  case JJSON_NUMBER:
+    *out = val->data.number;
+    return 1;
+  case JJSON_RAW_NUMBER:
+    return JJE_OK == jjson__raw_to_int64(val->data.raw_number.text, val->data.raw_number.length, out);
+  default:
+    return -1;
+  }
+}
+
+jjson_bool jjson__number_equal(const jjson_value *a, const jjson_value *b)
+{
+  long long ia = 0, ib = 0;
+  int a_int = jjson__number_as_int64(a, &ia);
+  int b_int = jjson__number_as_int64(b, &ib);
+  if (a_int < 0 || b_int < 0)
+  {
+    return JJSON_FALSE;
+  }
+  if (a_int && b_int)
+  {
+    return ia == ib ? JJSON_TRUE : JJSON_FALSE;
+  }
+  // non-integers are only equal when spelled the same way
+  if (a->type == JJSON_RAW_NUMBER && b->type == JJSON_RAW_NUMBER && a->data.raw_number.length == b->data.raw_number.length)
+  {
+    return memcmp(a->data.raw_number.text, b->data.raw_number.text, a->data.raw_number.length) == 0 ? JJSON_TRUE : JJSON_FALSE;
+  }
+  return JJSON_FALSE;
+}
+
+/**
+ * JSON Parser
+ */
+
+enum jjson_error jjson__parser_bump(jjson__parser *p);
+enum jjson_error jjson__parser_expect(jjson__parser *p, jjson__tkn_type tt);
+enum jjson_error jjson__parse_json_object(jjson__parser *p, jjson_t *json);
+enum jjson_error jjson__parse_json_value(jjson__parser *p, jjson_value *val);
+enum jjson_error jjson__parse_json_array(jjson__parser *p, jjson_array *arr);
+enum jjson_error jjson__parse_json_key_value(jjson__parser *p, jjson_key_value *kv);
+void jjson__parser_finish_object_hash(jjson__parser *p, jjson_t *json, unsigned long long fields_hash);
+void jjson__parser_drop_value(jjson__parser *p, jjson_value *val);
+void jjson__parser_drop_tokens(jjson__parser *p);
+
+enum jjson_error jjson_parse(jjson_t *json, const char *content, size_t content_len)
+{
+  return jjson_parse_ex(json, content, content_len, JJSON_PARSE_DEFAULT);
+}
+
+enum jjson_error jjson_parse_ex(jjson_t *json, const char *content, size_t content_len, unsigned flags)
+{
+  jjson__parser p = {0};
+  p.flags = flags;
+  jjson__lexer_init(&p.lexer, content, content_len);
+  p.lexer.raw_numbers = (flags & JJSON_PARSE_RAW_NUMBERS) != 0;
+  p.lexer.pool = json->pool;
+  p.object = json;
+  enum jjson_error err = jjson__parser_bump(&p);
+  if (JJE_OK == err)
+    err = jjson__parser_bump(&p);
+  if (JJE_OK == err)
+    err = jjson__parse_json_object(&p, json);
+  // the root '}' is never consumed, so anything after it is still the next token
+  if (JJE_OK == err && p.curr_token.type != JJSON__TOKEN_EOF && p.next_token.type != JJSON__TOKEN_EOF)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unexpected '%s' after Json document at %lu:%lu", JJSON__TOKEN_TYPE(p.next_token.type), p.next_token.pos.line, p.next_token.pos.colm);
+    err = JJE_INVALID_TKN;
+  }
+  if (JJE_OK != err)
+    jjson__parser_drop_tokens(&p);
+  return err;
+}
+
+enum jjson_error jjson__parse_json_object(jjson__parser *p, jjson_t *json)
+{
+  enum jjson_error err = JJE_OK;
+  unsigned long long fields_hash = 0;
+  if (p->curr_token.type == JJSON__TOKEN_EOF)
+  {
+    // There is nothing to be parsed
+    jjson__parser_finish_object_hash(p, json, fields_hash);
+    return JJE_OK;
+  }
+  err = jjson__parser_expect(p, JJSON__TOKEN_LBRACE);
+  if (JJE_OK != err)
+    return err;
+  if (p->curr_token.type == JJSON__TOKEN_RBRACE)
+  {
+    jjson__parser_finish_object_hash(p, json, fields_hash);
+    return JJE_OK;
+  }
+  while (1)
+  {
+    jjson_key_value kv = {0};
+    err = jjson__parse_json_key_value(p, &kv);
+    if (JJE_OK != err)
+    {
+      if (!p->lexer.pool)
+        free((void *)kv.key);
+      return err;
+    }
+    err = jjson__add_field(json, kv);
+    if (JJE_OK != err)
+      return err;
+    if (p->flags & JJSON_PARSE_HASH)
+    {
+      fields_hash += jjson__hash_field(kv.key, p->value_hash);
+    }
+    if (p->curr_token.type == JJSON__TOKEN_RBRACE)
+    {
+      break;
+    }
+    if (p->curr_token.type != JJSON__TOKEN_COMMA)
+    {
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected ',' or '}' after Json Object member at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
+      return JJE_INVALID_TKN;
+    }
+    err = jjson__parser_bump(p);
+    if (JJE_OK != err)
+      return err;
+  }
+  jjson__parser_finish_object_hash(p, json, fields_hash);
+  return JJE_OK;
+}
+
+void jjson__parser_finish_object_hash(jjson__parser *p, jjson_t *json, unsigned long long fields_hash)
+{
+  if (p->flags & JJSON_PARSE_HASH)
+  {
+    json->hash = jjson__hash_finish_object(fields_hash, json->field_count);
+    p->value_hash = json->hash;
+  }
+}
+
+/*
+ * A value whose parse failed never reaches its parent, so give back what it
+ * holds here: to the free lists of a reset document, otherwise to the heap.
+ */
+void jjson__parser_drop_value(jjson__parser *p, jjson_value *val)
+{
+  if (p->lexer.pool)
+    jjson__pool_recycle_value(p->lexer.pool, val);
+  else
+    jjson_deinit_value(val);
+}
+
+/*
+ * Frees the strings of the two lookahead tokens after a failed parse. Neither
+ * has been handed to a value or key yet: those take the current token right
+ * before bumping past it.
+ */
+void jjson__parser_drop_tokens(jjson__parser *p)
+{
+  if (p->lexer.pool)
+    return;
+  if (p->curr_token.type == JJSON__TOKEN_STRING)
+    free(p->curr_token.label.string);
+  if (p->next_token.type == JJSON__TOKEN_STRING)
+    free(p->next_token.label.string);
+}
+
+enum jjson_error jjson__parse_json_key_value(jjson__parser *p, jjson_key_value *kv)
+{
+  enum jjson_error err = JJE_OK;
+  if (p->curr_token.type != JJSON__TOKEN_STRING)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected JSON key to be string at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
+    return JJE_INVALID_TKN;
+  }
+  kv->key = p->curr_token.label.string;
+  err = jjson__parser_bump(p);
+  if (JJE_OK != err)
+    return err;
+  err = jjson__parser_expect(p, JJSON__TOKEN_COLON);
+  if (JJE_OK != err)
+    return err;
+  err = jjson__parse_json_value(p, &kv->value);
+  if (JJE_OK == err && p->lexer.pool)
+    kv->value.in_arena |= JJSON_IN_ARENA_KEY;
+  return err;
+}
+
+enum jjson_error jjson__parse_json_value(jjson__parser *p, jjson_value *val)
+{
+  enum jjson_error err = JJE_OK;
+  val->in_arena = 0;
+  switch (p->curr_token.type)
+  {
+  case JJSON__TOKEN_NUMBER:
+    if (p->flags & JJSON_PARSE_RAW_NUMBERS)
+    {
+      val->type = JJSON_RAW_NUMBER;
+      val->data.raw_number.text = p->curr_token.label.raw.text;
+      val->data.raw_number.length = (unsigned int)p->curr_token.label.raw.length;
+      val->data.raw_number.cached = 0;
+      break;
+    }
+    val->type = JJSON_NUMBER;
+    val->data.number = p->curr_token.label.number;
+    break;
+  case JJSON__TOKEN_STRING:
+    val->type = JJSON_STRING;
+    val->in_arena = p->lexer.pool ? JJSON_IN_ARENA_STRING : 0;
+    val->data.string = p->curr_token.label.string;
+    break;
+  case JJSON__TOKEN_LPAREN:
+    val->type = JJSON_ARRAY;
+    err = jjson__pool_array(p->lexer.pool, &val->data.array);
+    if (JJE_OK != err)
+      return err;
+    err = jjson__parse_json_array(p, &val->data.array);
+    if (JJE_OK != err)
+    {
+      jjson__parser_drop_value(p, val);
+      return err;
+    }
+    break;
+  case JJSON__TOKEN_LBRACE:
+    val->type = JJSON_OBJECT;
+    val->data.object = jjson__pool_object(p->lexer.pool);
+    if (!val->data.object)
+      return JJE_ALLOC_FAIL;
+    val->data.object->parent = p->object;
+    p->object = val->data.object;
+    err = jjson__parse_json_object(p, val->data.object);
+    p->object = val->data.object->parent;
+    if (JJE_OK != err)
+    {
+      jjson__parser_drop_value(p, val);
+      return err;
+    }
+    break;
+  case JJSON__TOKEN_NULL:
+    val->type = JJSON_NULL;
+    break;
+  case JJSON__TOKEN_TRUE:
+    val->type = JJSON_BOOLEAN;
+    val->data.boolean = JJSON_TRUE;
+    break;
+  case JJSON__TOKEN_FALSE:
+    val->type = JJSON_BOOLEAN;
+    val->data.boolean = JJSON_FALSE;
+    break;
+  default:
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unsupported JSON value at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
+    return JJE_INVALID_TKN;
+  }
+  // containers hash themselves as they are parsed
+  if ((p->flags & JJSON_PARSE_HASH) && val->type != JJSON_ARRAY && val->type != JJSON_OBJECT)
+  {
+    p->value_hash = jjson__hash_value(val);
+  }
+  err = jjson__parser_bump(p);
+  if (JJE_OK != err)
+    jjson__parser_drop_value(p, val);
+  return err;
+}
+
+enum jjson_error jjson_init_array(jjson_array *arr)
+{
+  arr->length = 0;
+  arr->capacity = JSON_CAPACITY_INCR_RATE;
+  arr->items = (jjson_value *)malloc(sizeof(jjson_value) * JSON_CAPACITY_INCR_RATE);
+  // TODO: check malloc result
+  return JJE_OK;
+}
+
+enum jjson_error jjson__array_append(jjson_array *array, jjson_value val);
+
+enum jjson_error jjson_array_push(jjson_array *array, jjson_value val)
+{
+  // as in jjson_add, strings handed in by the caller are freed with the array
+  val.in_arena = 0;
+  return jjson__array_append(array, val);
+}
+
+// jjson_array_push keeping the arena bits of `val`
+enum jjson_error jjson__array_append(jjson_array *array, jjson_value val)
+{
+  if (array->length >= array->capacity)
+  {
+    size_t new_cap = array->capacity + JSON_CAPACITY_INCR_RATE;
+    array->items = (jjson_value *)realloc(array->items, sizeof(jjson_value) * new_cap);
+    // TODO: check malloc result
+    array->capacity = new_cap;
+  }
+  array->items[array->length++] = val;
+  return JJE_OK;
+}
+
+enum jjson_error jjson__parse_json_array(jjson__parser *p, jjson_array *arr)
+{
+  enum jjson_error err = JJE_OK;
+  unsigned long long items_hash = JJSON__HASH_ARRAY;
+  err = jjson__parser_expect(p, JJSON__TOKEN_LPAREN);
+  if (JJE_OK != err)
+    return err;
+  while (p->curr_token.type != JJSON__TOKEN_RPAREN)
+  {
+    jjson_value val;
+    err = jjson__parse_json_value(p, &val);
+    if (JJE_OK != err)
+      return err;
+    err = jjson__array_append(arr, val);
+    if (JJE_OK != err)
+      return err;
+    if (p->flags & JJSON_PARSE_HASH)
+    {
+      items_hash = jjson__hash_mix(items_hash ^ p->value_hash);
+    }
+    if (p->curr_token.type == JJSON__TOKEN_RPAREN)
+    {
+      break;
+    }
+    if (p->curr_token.type != JJSON__TOKEN_COMMA)
+    {
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected ',' to separated Json Array items at "
+                                                                    "%lu:%lu",
+               p->curr_token.pos.line, p->curr_token.pos.colm);
+      return JJE_INVALID_TKN;
+    }
+    err = jjson__parser_bump(p);
+    if (JJE_OK != err)
+      return err;
+    if (p->curr_token.type == JJSON__TOKEN_RPAREN)
+    {
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Trailing ',' in Json Array at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
+      return JJE_INVALID_TKN;
+    }
+  }
+  if (p->flags & JJSON_PARSE_HASH)
+  {
+    p->value_hash = jjson__hash_finish_array(items_hash, arr->length);
+  }
+  return err;
+}
+
+enum jjson_error jjson__parser_bump(jjson__parser *p)
+{
+  p->curr_token = p->next_token;
+  // stored even when invalid so no token is left in both slots
+  jjson__lexer_next_token(&p->lexer, &p->next_token);
+  jjson__token *tkn = &p->next_token;
+  switch (tkn->type)
+  {
+  case JJSON__TOKEN_INVALID:
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN - 1, "[JSON ERROR]: Invalid symbol '%c' at %lu:%lu", tkn->label.chr, tkn->pos.line, tkn->pos.colm);
+    return JJE_INVALID_TKN;
+  case JJSON__TOKEN_BAD_STRING:
+    // the lexer already described what is wrong with the string
+    return JJE_INVALID_TKN;
+  default:
+    break;
+  }
+  return JJE_OK;
+}
+
+enum jjson_error jjson__parser_expect(jjson__parser *p, jjson__tkn_type tt)
+{
+  if (p->curr_token.type != tt)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected '%s' but got '%s' at %lu:%lu", JJSON__TOKEN_TYPE(tt), JJSON__TOKEN_TYPE(p->curr_token.type), p->curr_token.pos.line, p->curr_token.pos.colm);
+    return JJE_INVALID_TKN;
+  }
+  return jjson__parser_bump(p);
+}
+
+/**
+ * JSON Validator
+ */
+
+enum jjson__scan_state
+{
+  // a value is expected
+  JJSON__SCAN_VALUE,
+  // a member `"key":` is expected
+  JJSON__SCAN_KEY,
+  // just after '{' or '[', which may close right away
+  JJSON__SCAN_OPENED,
+  // a value just ended
+  JJSON__SCAN_AFTER,
+};
+
+size_t jjson__skip_json_whitespace(const char *s, size_t i, size_t len);
+size_t jjson__validate_number(const char *s, size_t i, size_t len, const char **problem);
+size_t jjson__validate_key(const char *s, size_t i, size_t len, const char **problem);
+int jjson__string_cut(const char *s, size_t at, size_t len);
+
+size_t jjson__skip_json_whitespace(const char *s, size_t i, size_t len)
+{
+  while (i < len && (s[i] == ' ' || s[i] == '\n' || s[i] == '\r' || s[i] == '\t'))
+  {
+    i += 1;
+  }
+  return i;
+}
+
+// Checks the number at `s[i]` and returns the index just past it, or of the offending byte
+size_t jjson__validate_number(const char *s, size_t i, size_t len, const char **problem)
+{
+  size_t start = i;
+  if (i < len && s[i] == '-')
+    i += 1;
+  if (i >= len || !isdigit((unsigned char)s[i]))
+  {
+    // a lone '-' is still a malformed number, anything else is no value at all
+    *problem = i == start ? "Expected a value" : "Expected a digit";
+    return i;
+  }
+  if (s[i] == '0')
+  {
+    i += 1;
+  }
+  else
+  {
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  if (i < len && s[i] == '.')
+  {
+    i += 1;
+    if (i >= len || !isdigit((unsigned char)s[i]))
+    {
+      *problem = "Expected a digit after '.'";
+      return i;
+    }
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  if (i < len && (s[i] == 'e' || s[i] == 'E'))
+  {
+    i += 1;
+    if (i < len && (s[i] == '+' || s[i] == '-'))
+      i += 1;
+    if (i >= len || !isdigit((unsigned char)s[i]))
+    {
+      *problem = "Expected a digit in exponent";
+      return i;
+    }
+    while (i < len && isdigit((unsigned char)s[i]))
+      i += 1;
+  }
+  return i;
+}
+
+// Checks `"key" :` at `s[i]` and returns the index of the member value
+size_t jjson__validate_key(const char *s, size_t i, size_t len, const char **problem)
+{
+  if (i >= len || s[i] != '"')
+  {
+    *problem = "Expected a string key";
+    return i;
+  }
+  size_t end;
+  unsigned flags = 0;
+  if (JJE_OK != jjson__scan_string(s, i + 1, len, &end, &flags))
+  {
+    // jjson__scan_string already wrote the message
+    *problem = "";
+    return end;
+  }
+  i = jjson__skip_json_whitespace(s, end + 1, len);
+  if (i >= len || s[i] != ':')
+  {
+    *problem = "Expected ':'";
+    return i;
+  }
+  return jjson__skip_json_whitespace(s, i + 1, len);
+}
+
+// Whether a string that failed to scan at `s[at]` may just be cut short by the end of the input
+int jjson__string_cut(const char *s, size_t at, size_t len)
+{
+  // the longest escape is a surrogate pair, `\uXXXX\uXXXX`
+  return at >= len || (s[at] == '\\' && len - at < 12);
+}
+
+void jjson_scanner_init(jjson_scanner *sc)
+{
+  sc->pos = 0;
+  sc->start = 0;
+  sc->depth = 0;
+  sc->state = JJSON__SCAN_VALUE;
+}
+
+/*
+ * Finds the next value in `content[sc->pos..content_len)` and checks it like
+ * jjson_validate, keeping only one bit per open container. Returns JJE_OK with
+ * the value at `content[*start..*end)`, after which the next call continues
+ * past it. Returns JJE_NOT_FOUND when only whitespace is left, or when `more`
+ * says the input continues and the value is cut short; the next call with a
+ * longer buffer then resumes where this one stopped instead of starting over.
+ * Malformed input gives JJE_INVALID_TKN with `*end` at the first bad byte.
+ */
+enum jjson_error jjson_scan(jjson_scanner *sc, const char *content, size_t content_len, int more, size_t *start, size_t *end)
+{
+  const char *s = content;
+  size_t len = content_len;
+  size_t i = sc->pos;
+  size_t depth = sc->depth;
+  int state = sc->state;
+  unsigned char *stack = sc->stack;
+  // token boundary where the next call resumes if the input runs out
+  size_t mark = i;
+  int cut = 0;
+  const char *problem = NULL;
+
+  while (problem == NULL && !cut)
+  {
+    if (state == JJSON__SCAN_AFTER && depth == 0)
+    {
+      sc->pos = i;
+      sc->state = JJSON__SCAN_VALUE;
+      sc->depth = 0;
+      *start = sc->start;
+      *end = i;
+      return JJE_OK;
+    }
+    mark = i;
+    i = jjson__skip_json_whitespace(s, i, len);
+    if (depth == 0 && state == JJSON__SCAN_VALUE)
+    {
+      mark = i;
+      sc->start = i;
+      if (i >= len)
+      {
+        cut = 1;
+        break;
+      }
+    }
+    if (more && i >= len)
+    {
+      cut = 1;
+      break;
+    }
+
+    // each case falls through to the next once its token is complete, so
+    // a member or item usually takes one trip around the loop
+    switch (state)
+    {
+    case JJSON__SCAN_OPENED:
+    {
+      int in_object = (stack[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1;
+      if (i < len && s[i] == (in_object ? '}' : ']'))
+      {
+        depth -= 1;
+        i += 1;
+        state = JJSON__SCAN_AFTER;
+        break;
+      }
+      state = in_object ? JJSON__SCAN_KEY : JJSON__SCAN_VALUE;
+      if (!in_object)
+        break;
+    }
+      // fallthrough
+    case JJSON__SCAN_KEY:
+      i = jjson__validate_key(s, i, len, &problem);
+      if (problem)
+      {
+        cut = more && (i >= len || (!problem[0] && jjson__string_cut(s, i, len)));
+        break;
+      }
+      mark = i;
+      state = JJSON__SCAN_VALUE;
+      // fallthrough
+    case JJSON__SCAN_VALUE:
+    {
+      char c = i < len ? s[i] : '\0';
+      if (c == '{' || c == '[')
+      {
+        if (depth == JJSON_SCAN_MAX_DEPTH)
+        {
+          problem = "Nesting too deep";
+          break;
+        }
+        if (c == '{')
+          stack[depth / 8] |= (unsigned char)(1u << (depth % 8));
+        else
+          stack[depth / 8] &= (unsigned char)~(1u << (depth % 8));
+        depth += 1;
+        i += 1;
+        state = JJSON__SCAN_OPENED;
+        break;
+      }
+      if (c == '"')
+      {
+        size_t str_end;
+        unsigned flags = 0;
+        if (JJE_OK != jjson__scan_string(s, i + 1, len, &str_end, &flags))
+        {
+          cut = more && jjson__string_cut(s, str_end, len);
+          i = str_end;
+          problem = "";
+          break;
+        }
+        i = str_end + 1;
+      }
+      else if (c == 't' || c == 'f' || c == 'n')
+      {
+        const char *word = c == 't' ? "true" : c == 'f' ? "false" : "null";
+        size_t word_len = c == 'f' ? 5 : 4;
+        if (len - i < word_len || memcmp(s + i, word, word_len) != 0)
+        {
+          cut = more && len - i < word_len && memcmp(s + i, word, len - i) == 0;
+          problem = "Invalid literal";
+          break;
+        }
+        i += word_len;
+      }
+      else
+      {
+        i = jjson__validate_number(s, i, len, &problem);
+        // a number running into the end of the input may continue in the next read
+        cut = more && i >= len;
+        if (problem || cut)
+          break;
+      }
+      state = JJSON__SCAN_AFTER;
+      if (depth == 0)
+        break;
+      mark = i;
+      i = jjson__skip_json_whitespace(s, i, len);
+      if (more && i >= len)
+      {
+        cut = 1;
+        break;
+      }
+    }
+      // fallthrough
+    case JJSON__SCAN_AFTER:
+    {
+      // close containers until one continues with ','
+      int in_object = (stack[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1;
+      if (i < len && s[i] == ',')
+      {
+        i += 1;
+        state = in_object ? JJSON__SCAN_KEY : JJSON__SCAN_VALUE;
+      }
+      else if (i >= len || s[i] != (in_object ? '}' : ']'))
+      {
+        problem = in_object ? "Expected ',' or '}'" : "Expected ',' or ']'";
+      }
+      else
+      {
+        depth -= 1;
+        i += 1;
+      }
+      break;
+    }
+    }
+  }
+
+  if (cut)
+  {
+    // `state` and `depth` still describe the input at `mark`
+    sc->pos = mark;
+    sc->state = state;
+    sc->depth = depth;
+    return JJE_NOT_FOUND;
+  }
+  if (problem[0])
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: %s at offset %lu", problem, (unsigned long)i);
+  }
+  else
+  {
+    size_t msg_len = strlen(jjson__last_error_message);
+    snprintf(jjson__last_error_message + msg_len, JJSON__ERROR_MSG_MAX_LEN - msg_len, " at offset %lu", (unsigned long)i);
+  }
+  sc->pos = mark;
+  sc->state = state;
+  sc->depth = depth;
+  *end = i;
+  return JJE_INVALID_TKN;
+}
+
+/*
+ * Checks that `content` is exactly one JSON value per RFC 8259 (strict
+ * commas, no trailing data, valid escapes and UTF-8) without building a tree
+ * or allocating. On failure `*error_offset` is the offset of the first bad
+ * byte and jjson_strerror describes the problem.
+ */
+enum jjson_error jjson_validate(const char *content, size_t content_len, size_t *error_offset)
+{
+  jjson_scanner sc;
+  jjson_scanner_init(&sc);
+  size_t start;
+  size_t end;
+  enum jjson_error err = jjson_scan(&sc, content, content_len, 0, &start, &end);
+  if (JJE_OK == err)
+  {
+    end = jjson__skip_json_whitespace(content, end, content_len);
+    if (end == content_len)
+      return JJE_OK;
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unexpected data after Json document at offset %lu", (unsigned long)end);
+    err = JJE_INVALID_TKN;
+  }
+  else if (JJE_NOT_FOUND == err)
+  {
+    end = content_len;
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected a value at offset %lu", (unsigned long)end);
+    err = JJE_INVALID_TKN;
+  }
+  if (error_offset)
+  {
+    *error_offset = end;
+  }
+  return err;
+}
+
+/**
+ * JSON Reformatting
+ */
+
+size_t jjson__scan_minify_special(const char *s, size_t i, size_t len);
+int jjson__values_touch(char prev, char next);
+enum jjson_error jjson__missing_separator(size_t offset);
+void jjson__prettify_newline(FILE *out, size_t spaces);
+
+// Whether `prev` can end a value and `next` start one, so nothing separates two values
+int jjson__values_touch(char prev, char next)
+{
+  return !memchr("{[,:", prev, 4) && !memchr("}],: \t\n\r", next, 8);
+}
+
+enum jjson_error jjson__missing_separator(size_t offset)
+{
+  snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected ',' or ':' between values at offset %lu", (unsigned long)offset);
+  return JJE_INVALID_TKN;
+}
+
+/*
+ * Returns the index of the first whitespace byte or `"` in `s[i..len)`, or
+ * `len` when there is none. Everything before it is copied verbatim by minify.
+ */
+size_t jjson__scan_minify_special(const char *s, size_t i, size_t len)
+{
+#if defined(JJSON__AVX2)
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i space32 = _mm256_set1_epi8(' ');
+  const __m256i tab32 = _mm256_set1_epi8('\t');
+  const __m256i lf32 = _mm256_set1_epi8('\n');
+  const __m256i cr32 = _mm256_set1_epi8('\r');
+  for (; i + 32 <= len; i += 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, space32)),
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, tab32), _mm256_cmpeq_epi8(chunk, lf32)),
+                        _mm256_cmpeq_epi8(chunk, cr32)));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+#if defined(JJSON__SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, space)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, tab), _mm_cmpeq_epi8(chunk, lf)),
+                     _mm_cmpeq_epi8(chunk, cr)));
+    unsigned mask = (unsigned)_mm_movemask_epi8(special);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < len; ++i)
+  {
+    char c = s[i];
+    if (c == '"' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+      return i;
+  }
+  return len;
+}
+
+/*
+ * Removes insignificant whitespace from `in` without building a tree. `out`
+ * must hold `in_len` bytes and may be `in` itself for in-place minification;
+ * the result is not NUL-terminated and its length is stored in `*out_len`.
+ * Strings are checked (escapes and UTF-8), and values that only whitespace or
+ * string quotes keep apart are rejected instead of being joined (`1 2` would
+ * become `12`). The rest of the grammar is not checked, use jjson_validate
+ * first when the input is untrusted.
+ */
+enum jjson_error jjson_minify(const char *in, size_t in_len, char *out, size_t *out_len)
+{
+  size_t i = 0;
+  size_t o = 0;
+  while (i < in_len)
+  {
+    // every pass starts after whitespace or a string, where two values may meet
+    if (o > 0 && jjson__values_touch(out[o - 1], in[i]))
+      return jjson__missing_separator(i);
+    size_t run_end = jjson__scan_minify_special(in, i, in_len);
+    // `o` never passes `i`, so the copy only overlaps when minifying in place
+    memmove(out + o, in + i, run_end - i);
+    o += run_end - i;
+    i = run_end;
+    if (i >= in_len)
+    {
+      break;
+    }
+    if (in[i] != '"')
+    {
+      i = jjson__skip_json_whitespace(in, i, in_len);
+      continue;
+    }
+    if (o > 0 && jjson__values_touch(out[o - 1], '"'))
+      return jjson__missing_separator(i);
+    size_t end;
+    unsigned flags = 0;
+    if (JJE_OK != jjson__scan_string(in, i + 1, in_len, &end, &flags))
+    {
+      size_t msg_len = strlen(jjson__last_error_message);
+      snprintf(jjson__last_error_message + msg_len, JJSON__ERROR_MSG_MAX_LEN - msg_len, " at offset %lu", (unsigned long)end);
+      return JJE_INVALID_TKN;
+    }
+    memmove(out + o, in + i, end + 1 - i);
+    o += end + 1 - i;
+    i = end + 1;
+  }
+  *out_len = o;
+  return JJE_OK;
+}
+
+void jjson__prettify_newline(FILE *out, size_t spaces)
+{
+  static const char blanks[] = "                                ";
+  fputc('\n', out);
+  while (spaces > 0)
+  {
+    size_t n = spaces < sizeof(blanks) - 1 ? spaces : sizeof(blanks) - 1;
+    fwrite(blanks, sizeof(char), n, out);
+    spaces -= n;
+  }
+}
+
+/*
+ * Writes `in` to `out` with one member or item per line, `indent` spaces per
+ * level and `"key": value` spacing, without building a tree. Only one bit per
+ * open container is kept, as in jjson_validate, so memory use is constant.
+ * Strings are checked, brackets must balance and match, and a value must not
+ * follow another without ',' or ':' in between; other grammar errors are
+ * passed through.
+ */
+enum jjson_error jjson_prettify(const char *in, size_t in_len, FILE *out, int indent)
+{
+  // one bit per open container: 1 for objects, 0 for arrays
+  unsigned char stack[JJSON_SCAN_MAX_DEPTH / 8];
+  size_t depth = 0;
+  size_t step = indent > 0 ? (size_t)indent : 0;
+  // set once a value has been written, cleared by the bytes that may precede one
+  int after_value = 0;
+  size_t i = jjson__skip_json_whitespace(in, 0, in_len);
+  while (i < in_len)
+  {
+    char c = in[i];
+    if (after_value && c != '}' && c != ']' && c != ',' && c != ':')
+      return jjson__missing_separator(i);
+    switch (c)
+    {
+    case '"':
+    {
+      size_t end;
+      unsigned flags = 0;
+      if (JJE_OK != jjson__scan_string(in, i + 1, in_len, &end, &flags))
+      {
+        size_t msg_len = strlen(jjson__last_error_message);
+        snprintf(jjson__last_error_message + msg_len, JJSON__ERROR_MSG_MAX_LEN - msg_len, " at offset %lu", (unsigned long)end);
+        return JJE_INVALID_TKN;
+      }
+      fwrite(in + i, sizeof(char), end + 1 - i, out);
+      i = end + 1;
+      after_value = 1;
+      break;
+    }
+    case '{':
+    case '[':
+    {
+      char close = c == '{' ? '}' : ']';
+      fputc(c, out);
+      i = jjson__skip_json_whitespace(in, i + 1, in_len);
+      if (i < in_len && in[i] == close)
+      {
+        // empty containers stay on one line
+        fputc(close, out);
+        i += 1;
+        after_value = 1;
+        break;
+      }
+      if (depth == JJSON_SCAN_MAX_DEPTH)
+      {
+        snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Nesting too deep at offset %lu", (unsigned long)i);
+        return JJE_INVALID_TKN;
+      }
+      if (c == '{')
+        stack[depth / 8] |= (unsigned char)(1u << (depth % 8));
+      else
+        stack[depth / 8] &= (unsigned char)~(1u << (depth % 8));
+      depth += 1;
+      jjson__prettify_newline(out, depth * step);
+      break;
+    }
+    case '}':
+    case ']':
+    {
+      if (depth == 0)
+      {
+        snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unbalanced '%c' at offset %lu", c, (unsigned long)i);
+        return JJE_INVALID_TKN;
+      }
+      int in_object = (stack[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1;
+      if (c != (in_object ? '}' : ']'))
+      {
+        snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected '%c' but found '%c' at offset %lu", in_object ? '}' : ']', c, (unsigned long)i);
+        return JJE_INVALID_TKN;
+      }
+      depth -= 1;
+      jjson__prettify_newline(out, depth * step);
+      fputc(c, out);
+      i += 1;
+      after_value = 1;
+      break;
+    }
+    case ',':
+      fputc(',', out);
+      jjson__prettify_newline(out, depth * step);
+      i += 1;
+      after_value = 0;
+      break;
+    case ':':
+      fwrite(": ", sizeof(char), 2, out);
+      i += 1;
+      after_value = 0;
+      break;
+    default:
+    {
+      // numbers and literals run until the next structural byte or whitespace
+      size_t start = i;
+      while (i < in_len && (in[i] == '\0' || !strchr("{}[],:\" \t\n\r", in[i])))
+      {
+        i += 1;
+      }
+      fwrite(in + start, sizeof(char), i - start, out);
+      after_value = 1;
+      break;
+    }
+    }
+    i = jjson__skip_json_whitespace(in, i, in_len);
+  }
+  if (depth != 0)
+  {
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unterminated Json container at offset %lu", (unsigned long)in_len);
+    return JJE_INVALID_TKN;
+  }
+  fputc('\n', out);
+  return JJE_OK;
+}
+
+/**
+ * JSON Stringifier
+ */
+
+void jjson__stringify_json_object(jjson__stringfier *ctx, const jjson_t *obj);
+void jjson__stringify_json_value(jjson__stringfier *ctx, jjson_value val);
+void jjson__stringify_json_array(jjson__stringfier *ctx, jjson_array arr);
+void jjson__stringify_object_fields(jjson__stringfier *ctx, const jjson_t *obj, size_t begin, size_t end);
+void jjson__stringify_object_close(jjson__stringfier *ctx);
+void jjson__stringify_array_items(jjson__stringfier *ctx, const jjson_array *arr, size_t begin, size_t end);
+void jjson__stringfier_print_tab(jjson__stringfier *ctx);
+void jjson__stringify_string(jjson__stringfier *ctx, const char *str);
+size_t jjson__scan_needs_escape(const char *s, size_t i, size_t len, int ascii_only);
+
+enum jjson_error jjson_stringify(const jjson_t *obj, short depth, char **out)
+{
+  return jjson_stringify_ex(obj, depth, JJSON_STRINGIFY_DEFAULT, out);
+}
+
+enum jjson_error jjson_stringify_ex(const jjson_t *obj, short depth, unsigned flags, char **out)
+{
+  unsigned long buf_len = 0;
+  jjson__stringfier ctx;
+  ctx.tab = depth;
+  ctx.tab_rate = depth;
+  ctx.flags = flags;
+  ctx.stream = open_memstream(out, &buf_len);
+  jjson__stringify_json_object(&ctx, obj);
+  fclose(ctx.stream);
+  return JJE_OK;
+}
+
+void jjson__stringify_json_object(jjson__stringfier *ctx, const jjson_t *obj)
+{
+  fprintf(ctx->stream, "{\n");
+  jjson__stringify_object_fields(ctx, obj, 0, obj->field_count);
+  jjson__stringify_object_close(ctx);
+}
+
+// Writes fields [begin, end) of `obj`, each on its own line at the current tab
+void jjson__stringify_object_fields(jjson__stringfier *ctx, const jjson_t *obj, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    jjson__stringfier_print_tab(ctx);
+    jjson__stringify_string(ctx, obj->fields[i].key);
+    fprintf(ctx->stream, ": ");
+    jjson__stringify_json_value(ctx, obj->fields[i].value);
+    if (i + 1 < obj->field_count)
+    {
+      fprintf(ctx->stream, ",");
+    }
+    fprintf(ctx->stream, "\n");
+  }
+}
+
+void jjson__stringify_object_close(jjson__stringfier *ctx)
+{
+  ctx->tab == ctx->tab_rate ? fprintf(ctx->stream, "}\n") : ({
+    ctx->tab -= ctx->tab_rate;
+    jjson__stringfier_print_tab(ctx);
+    fprintf(ctx->stream, "}");
+    ctx->tab += ctx->tab_rate;
+  });
+}
+
+void jjson__stringify_json_value(jjson__stringfier *ctx, jjson_value val)
+{
+  switch (val.type)
+  {
+  case JJSON_NUMBER:
+    fprintf(ctx->stream, "%lld", val.data.number);
+    return;
+  case JJSON_RAW_NUMBER:
+    fwrite(val.data.raw_number.text, sizeof(char), val.data.raw_number.length, ctx->stream);
+    return;
+  case JJSON_STRING:
+    jjson__stringify_string(ctx, val.data.string);
+    return;
+  case JJSON_ARRAY:
+    jjson__stringify_json_array(ctx, val.data.array);
+    return;
+  case JJSON_OBJECT:
+    ctx->tab += ctx->tab_rate;
+    jjson__stringify_json_object(ctx, val.data.object);
+    ctx->tab -= ctx->tab_rate;
+    return;
+  case JJSON_NULL:
+    fprintf(ctx->stream, "null");
+    return;
+  case JJSON_BOOLEAN:
+    if (val.data.boolean)
+    {
+      fprintf(ctx->stream, "true");
+    }
+    else
+    {
+      fprintf(ctx->stream, "false");
+    }
+    return;
+  }
+}
+
+void jjson__stringify_json_array(jjson__stringfier *ctx, jjson_array arr)
+{
+  fprintf(ctx->stream, "[");
+  ctx->tab += ctx->tab_rate;
+  jjson__stringify_array_items(ctx, &arr, 0, arr.length);
+  ctx->tab -= ctx->tab_rate;
+  fprintf(ctx->stream, "\n");
+  jjson__stringfier_print_tab(ctx);
+  fprintf(ctx->stream, "]");
+}
+
+// Writes items [begin, end) of `arr`, each preceded by a newline and the current tab
+void jjson__stringify_array_items(jjson__stringfier *ctx, const jjson_array *arr, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    fprintf(ctx->stream, "\n");
+    jjson__stringfier_print_tab(ctx);
+    jjson__stringify_json_value(ctx, arr->items[i]);
+    if (i + 1 < arr->length)
+    {
+      fprintf(ctx->stream, ",");
+    }
+  }
+}
+
+/*
+ * Returns the index of the first byte in `s[i..len)` that cannot be written
+ * verbatim inside a JSON string, or `len` when the whole run is clean.
+ */
+size_t jjson__scan_needs_escape(const char *s, size_t i, size_t len, int ascii_only)
+{
+#if defined(JJSON__AVX2)
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i bslash32 = _mm256_set1_epi8('\\');
+  const __m256i ctrl32 = _mm256_set1_epi8(0x1F);
+  for (; i + 32 <= len; i += 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, bslash32)),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, ctrl32), ctrl32));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+    if (ascii_only)
+      mask |= (unsigned)_mm256_movemask_epi8(chunk);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+#if defined(JJSON__SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i ctrl = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, bslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, ctrl), ctrl));
+    unsigned mask = (unsigned)_mm_movemask_epi8(special);
+    if (ascii_only)
+      mask |= (unsigned)_mm_movemask_epi8(chunk);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < len; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\' || c < 0x20 || (ascii_only && c >= 0x80))
+      return i;
+  }
+  return len;
+}
+
+/*
+ * Writes `str` as a quoted JSON string. Clean spans go out with one fwrite,
+ * only the bytes found by the vector scan are escaped one at a time.
+ */
+void jjson__stringify_string(jjson__stringfier *ctx, const char *str)
+{
+  int ascii_only = (ctx->flags & JJSON_STRINGIFY_ASCII) != 0;
+  size_t len = strlen(str);
+  size_t i = 0;
+  fputc('"', ctx->stream);
+  while (i < len)
+  {
+    size_t special = jjson__scan_needs_escape(str, i, len, ascii_only);
+    fwrite(str + i, sizeof(char), special - i, ctx->stream);
+    if (special >= len)
+      break;
+    unsigned char c = (unsigned char)str[special];
+    i = special + 1;
+    switch (c)
+    {
+    case '"':
+      fputs("\\\"", ctx->stream);
+      continue;
+    case '\\':
+      fputs("\\\\", ctx->stream);
+      continue;
+    case '\b':
+      fputs("\\b", ctx->stream);
+      continue;
+    case '\f':
+      fputs("\\f", ctx->stream);
+      continue;
+    case '\n':
+      fputs("\\n", ctx->stream);
+      continue;
+    case '\r':
+      fputs("\\r", ctx->stream);
+      continue;
+    case '\t':
+      fputs("\\t", ctx->stream);
+      continue;
+    }
+    if (c < 0x80)
+    {
+      fprintf(ctx->stream, "\\u%04x", c);
+      continue;
+    }
+    // ASCII-only output: decode the UTF-8 sequence and emit it as \u escapes,
+    // replacing malformed bytes with U+FFFD
+    unsigned long cp = 0xFFFD;
+    size_t seq_len = jjson__validate_utf8(str + special, MIN(len - special, 4));
+    size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+    if (seq_len >= need)
+    {
+      cp = c & (0x7F >> need);
+      for (size_t k = 1; k < need; ++k)
+        cp = (cp << 6) | ((unsigned char)str[special + k] & 0x3F);
+      i = special + need;
+    }
+    if (cp >= 0x10000)
     {
-      token->type = JJSON__TOKEN_FALSE;
+      cp -= 0x10000;
+      fprintf(ctx->stream, "\\u%04lx\\u%04lx", 0xD800 + (cp >> 10), 0xDC00 + (cp & 0x3FF));
     }
     else
     {
-      token->type = JJSON__TOKEN_INVALID;
-      token->label.chr = buf[0];
+      fprintf(ctx->stream, "\\u%04lx", cp);
     }
+  }
+  fputc('"', ctx->stream);
+}
 
-    free(buf);
-    return;
+void jjson__stringfier_print_tab(jjson__stringfier *ctx)
+{
+  for (unsigned long i = 0; i < ctx->tab; ++i)
+  {
+    fprintf(ctx->stream, " ");
   }
+}
 
-  // parsing `+69` as `69`
-  if (l->curr_char == '+' && isdigit(l->content[l->read_pos]))
+void jjson_dump(const jjson_t *json, FILE *f, int depth)
+{
+  char *buf;
+  jjson_stringify(json, depth, &buf);
+  fprintf(f, "%s", buf);
+  free(buf);
+}
+
+enum jjson_error jjson_deinit(jjson_t *json)
+{
+  enum jjson_error err = jjson_deinit_object(json);
+  if (json->pool)
   {
-    jjson__lexer_advance_one(l);
+    jjson__pool_free(json->pool);
+    json->pool = NULL;
   }
+  return err;
+}
 
-  if (isdigit(l->curr_char) ||
-      ((l->curr_char == '-') && ((l->content_len > l->read_pos) && isdigit(l->content[l->read_pos]))))
+enum jjson_error jjson_deinit_object(jjson_t *json)
+{
+  enum jjson_error err = JJE_OK;
+  for (int i = 0; i < json->field_count; ++i)
   {
-    int is_signed = 0;
-    if (l->curr_char == '-')
+    jjson_key_value *kv = &json->fields[i];
+    // arena strings go away with the document's pool
+    if (!(kv->value.in_arena & JJSON_IN_ARENA_KEY))
+      free((void *)kv->key);
+    err = jjson_deinit_value(&kv->value);
+    if (JJE_OK != err)
     {
-      jjson__lexer_advance_one(l);
-      is_signed = 1;
+      return err;
     }
+  }
+  free(json->fields);
+  return JJE_OK;
+}
 
-    char *buf;
-    jjson__lexer_read_while(l, isdigit, &buf);
-    token->type = JJSON__TOKEN_NUMBER;
-    token->label.number = strtol(buf, NULL, 0);
-
-    if (is_signed)
+enum jjson_error jjson_deinit_array(jjson_array *arr)
+{
+  enum jjson_error err = JJE_OK;
+  for (int i = 0; i < arr->length; ++i)
+  {
+    err = jjson_deinit_value(&arr->items[i]);
+    if (JJE_OK != err)
     {
-      token->label.number -= (token->label.number * 2);
+      return err;
     }
-
-    free(buf);
-    return;
   }
+  free(arr->items);
+  return err;
+}
 
-  token->type = JJSON__TOKEN_INVALID;
-  token->label.chr = l->curr_char;
-  jjson__lexer_advance_one(l);
-  return;
+enum jjson_error jjson_deinit_value(jjson_value *val)
+{
+  enum jjson_error err = JJE_OK;
+  switch (val->type)
+  {
+  case JJSON_STRING:
+    if (!(val->in_arena & JJSON_IN_ARENA_STRING))
+      free(val->data.string);
+    break;
+  case JJSON_OBJECT:
+    err = jjson_deinit_object(val->data.object);
+    free(val->data.object);
+    break;
+  case JJSON_ARRAY:
+    err = jjson_deinit_array(&val->data.array);
+    break;
+  default:
+    break;
+  }
+  return err;
 }
 
 /**
- * JSON Parser
+ * Parallel Stringifier
  */
 
-enum jjson_error jjson__parser_bump(jjson__parser *p);
-enum jjson_error jjson__parser_expect(jjson__parser *p, jjson__tkn_type tt);
-enum jjson_error jjson__parse_json_object(jjson__parser *p, jjson_t *json);
-enum jjson_error jjson__parse_json_value(jjson__parser *p, jjson_value *val);
-enum jjson_error jjson__parse_json_array(jjson__parser *p, jjson_array *arr);
-enum jjson_error jjson__parse_json_key_value(jjson__parser *p, jjson_key_value *kv);
+#if defined(__linux__)
 
-enum jjson_error jjson_parse(jjson_t *json, const char *content, size_t content_len)
+// subtrees with fewer values than this are written by a single task
+#define JJSON__PARALLEL_MIN_VALUES 256
+// upper bound of the values per task, so a large document is not counted in full
+#define JJSON__PARALLEL_MAX_VALUES 4096
+
+/*
+ * One piece of the output. Tasks with `obj` or `arr` set serialize a range of
+ * fields or items on a worker; the others hold the glue text (brackets, keys,
+ * separators) written while planning.
+ */
+typedef struct
 {
-  jjson__parser p = {0};
-  jjson__lexer_init(&p.lexer, content, content_len);
-  enum jjson_error err = jjson__parser_bump(&p);
-  if (JJE_OK != err)
-    return err;
-  err = jjson__parser_bump(&p);
-  if (JJE_OK != err)
-    return err;
-  return jjson__parse_json_object(&p, json);
+  const jjson_t *obj;
+  const jjson_array *arr;
+  size_t begin;
+  size_t end;
+  size_t tab;
+  char *text;
+  size_t text_len;
+} jjson__stringify_task;
+
+typedef struct
+{
+  jjson__stringify_task *tasks;
+  size_t count;
+  size_t capacity;
+  size_t next;
+  size_t chunks;
+  // values per worker task the plan aims for
+  size_t grain;
+  size_t tab_rate;
+  unsigned flags;
+  // first failure of a worker, JJE_OK while all pieces are complete
+  enum jjson_error error;
+} jjson__stringify_plan;
+
+jjson__stringify_task *jjson__plan_push(jjson__stringify_plan *plan);
+size_t jjson__plan_weight(const jjson_value *val, size_t limit);
+enum jjson_error jjson__plan_children(jjson__stringify_plan *plan, const jjson_t *obj, const jjson_array *arr, size_t tab);
+enum jjson_error jjson__plan_value(jjson__stringify_plan *plan, const jjson_value *val, size_t tab);
+enum jjson_error jjson__plan_open_glue(jjson__stringify_plan *plan, jjson__stringfier *ctx, size_t tab);
+enum jjson_error jjson__plan_close_glue(jjson__stringfier *ctx);
+enum jjson_error jjson__plan_out_of_memory(void);
+void jjson__plan_fail(jjson__stringify_plan *plan);
+enum jjson_error jjson__plan_build(jjson__stringify_plan *plan, const jjson_t *obj, short depth, unsigned flags, size_t n_threads);
+void jjson__plan_free(jjson__stringify_plan *plan);
+void *jjson__stringify_worker(void *arg);
+enum jjson_error jjson__stringify_run(jjson__stringify_plan *plan, const jjson_t *obj, short depth, unsigned flags, size_t n_threads);
+
+enum jjson_error jjson__plan_out_of_memory(void)
+{
+  snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Out of memory serializing Json output pieces");
+  return JJE_ALLOC_FAIL;
 }
 
-enum jjson_error jjson__parse_json_object(jjson__parser *p, jjson_t *json)
+/*
+ * Records a worker failure, returned after the join. The message is written
+ * there too: jjson__last_error_message is per thread and the caller's is the
+ * one jjson_strerror reads.
+ */
+void jjson__plan_fail(jjson__stringify_plan *plan)
 {
-  enum jjson_error err = JJE_OK;
-  if (p->curr_token.type == JJSON__TOKEN_EOF)
+  __atomic_store_n(&plan->error, JJE_ALLOC_FAIL, __ATOMIC_RELAXED);
+}
+
+jjson__stringify_task *jjson__plan_push(jjson__stringify_plan *plan)
+{
+  if (plan->count == plan->capacity)
   {
-    // There is nothing to be parsed
-    return JJE_OK;
+    size_t new_cap = MAX(plan->capacity * 2, (size_t)64);
+    jjson__stringify_task *tasks = (jjson__stringify_task *)realloc(plan->tasks, sizeof(jjson__stringify_task) * new_cap);
+    if (!tasks)
+      return NULL;
+    plan->tasks = tasks;
+    plan->capacity = new_cap;
   }
-  err = jjson__parser_expect(p, JJSON__TOKEN_LBRACE);
-  if (JJE_OK != err)
-    return err;
-  if (p->curr_token.type == JJSON__TOKEN_RBRACE)
+  jjson__stringify_task *task = &plan->tasks[plan->count++];
+  memset(task, 0, sizeof(*task));
+  return task;
+}
+
+// Number of values in `val` and below it, counting stops once it reaches `limit`
+size_t jjson__plan_weight(const jjson_value *val, size_t limit)
+{
+  size_t weight = 1;
+  if (val->type == JJSON_ARRAY)
   {
-    return JJE_OK;
+    for (size_t i = 0; i < val->data.array.length && weight < limit; ++i)
+      weight += jjson__plan_weight(&val->data.array.items[i], limit - weight);
   }
-  while (1)
+  else if (val->type == JJSON_OBJECT)
   {
-    jjson_key_value kv = {0};
-    err = jjson__parse_json_key_value(p, &kv);
-    if (JJE_OK != err)
-      return err;
-    err = jjson_add(json, kv);
-    if (JJE_OK != err)
-      return err;
-    if (p->curr_token.type == JJSON__TOKEN_COMMA)
+    const jjson_t *obj = val->data.object;
+    for (size_t i = 0; i < obj->field_count && weight < limit; ++i)
+      weight += jjson__plan_weight(&obj->fields[i].value, limit - weight);
+  }
+  return weight;
+}
+
+// Starts a glue task whose text is written to `ctx->stream` until jjson__plan_close_glue
+enum jjson_error jjson__plan_open_glue(jjson__stringify_plan *plan, jjson__stringfier *ctx, size_t tab)
+{
+  jjson__stringify_task *task = jjson__plan_push(plan);
+  if (!task)
+    return jjson__plan_out_of_memory();
+  ctx->tab = tab;
+  ctx->tab_rate = plan->tab_rate;
+  ctx->flags = plan->flags;
+  ctx->stream = open_memstream(&task->text, &task->text_len);
+  if (!ctx->stream)
+    return jjson__plan_out_of_memory();
+  return JJE_OK;
+}
+
+enum jjson_error jjson__plan_close_glue(jjson__stringfier *ctx)
+{
+  // a memstream only fails when it cannot grow its buffer
+  if (fclose(ctx->stream) != 0)
+    return jjson__plan_out_of_memory();
+  return JJE_OK;
+}
+
+/*
+ * Plans the fields of `obj` (or the items of `arr`) printed at `tab`. Runs of
+ * small children are cut into worker tasks of about `plan->grain` values; a
+ * child holding a subtree that large is framed with glue text and planned
+ * the same way, so big values are split however deep they sit.
+ */
+enum jjson_error jjson__plan_children(jjson__stringify_plan *plan, const jjson_t *obj, const jjson_array *arr, size_t tab)
+{
+  enum jjson_error err = JJE_OK;
+  size_t count = obj ? obj->field_count : arr->length;
+  size_t run_start = 0;
+  size_t run_weight = 0;
+  for (size_t i = 0; i <= count; ++i)
+  {
+    const jjson_value *val = NULL;
+    size_t weight = 0;
+    if (i < count)
     {
-      err = jjson__parser_bump(p);
-      if (JJE_OK != err)
-        return err;
+      val = obj ? &obj->fields[i].value : &arr->items[i];
+      weight = jjson__plan_weight(val, plan->grain);
+      if (weight < plan->grain && run_weight + weight < plan->grain)
+      {
+        run_weight += weight;
+        continue;
+      }
     }
-    if (p->curr_token.type == JJSON__TOKEN_RBRACE)
+
+    // a small child that fills the run up to the grain closes it
+    int large = val && weight >= plan->grain;
+    size_t run_end = large || !val ? i : i + 1;
+    if (run_start < run_end)
     {
-      break;
+      jjson__stringify_task *task = jjson__plan_push(plan);
+      if (!task)
+        return jjson__plan_out_of_memory();
+      task->obj = obj;
+      task->arr = obj ? NULL : arr;
+      task->begin = run_start;
+      task->end = run_end;
+      task->tab = tab;
+    }
+    run_start = run_end;
+    run_weight = 0;
+    if (!large)
+      continue;
+    run_start = i + 1;
+
+    jjson__stringfier ctx;
+    err = jjson__plan_open_glue(plan, &ctx, tab);
+    if (JJE_OK != err)
+      return err;
+    if (obj)
+    {
+      jjson__stringfier_print_tab(&ctx);
+      jjson__stringify_string(&ctx, obj->fields[i].key);
+      fprintf(ctx.stream, ": ");
     }
-    if (p->curr_token.type == JJSON__TOKEN_EOF)
+    else
     {
-      break;
+      fprintf(ctx.stream, "\n");
+      jjson__stringfier_print_tab(&ctx);
     }
+    err = jjson__plan_close_glue(&ctx);
+    if (JJE_OK != err)
+      return err;
+
+    err = jjson__plan_value(plan, val, tab);
+    if (JJE_OK != err)
+      return err;
+
+    err = jjson__plan_open_glue(plan, &ctx, tab);
+    if (JJE_OK != err)
+      return err;
+    if (i + 1 < count)
+      fprintf(ctx.stream, ",");
+    if (obj)
+      fprintf(ctx.stream, "\n");
+    err = jjson__plan_close_glue(&ctx);
+    if (JJE_OK != err)
+      return err;
   }
   return JJE_OK;
 }
 
-enum jjson_error jjson__parse_json_key_value(jjson__parser *p, jjson_key_value *kv)
+// Plans a large array or object value printed at `tab`, as jjson__stringify_json_value would
+enum jjson_error jjson__plan_value(jjson__stringify_plan *plan, const jjson_value *val, size_t tab)
 {
-  enum jjson_error err = JJE_OK;
-  if (p->curr_token.type != JJSON__TOKEN_STRING)
-  {
-    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected JSON key to be string at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
-    return JJE_INVALID_TKN;
-  }
-  kv->key = p->curr_token.label.string;
-  err = jjson__parser_bump(p);
+  jjson__stringfier ctx;
+  enum jjson_error err = jjson__plan_open_glue(plan, &ctx, tab);
   if (JJE_OK != err)
     return err;
-  err = jjson__parser_expect(p, JJSON__TOKEN_COLON);
+  fprintf(ctx.stream, val->type == JJSON_OBJECT ? "{\n" : "[");
+  err = jjson__plan_close_glue(&ctx);
+  if (JJE_OK != err)
+    return err;
+
+  if (val->type == JJSON_OBJECT)
+    err = jjson__plan_children(plan, val->data.object, NULL, tab + plan->tab_rate);
+  else
+    err = jjson__plan_children(plan, NULL, &val->data.array, tab + plan->tab_rate);
+  if (JJE_OK != err)
+    return err;
+
+  err = jjson__plan_open_glue(plan, &ctx, tab);
   if (JJE_OK != err)
     return err;
-  return jjson__parse_json_value(p, &kv->value);
+  if (val->type == JJSON_OBJECT)
+  {
+    ctx.tab += plan->tab_rate;
+    jjson__stringify_object_close(&ctx);
+  }
+  else
+  {
+    fprintf(ctx.stream, "\n");
+    jjson__stringfier_print_tab(&ctx);
+    fprintf(ctx.stream, "]");
+  }
+  return jjson__plan_close_glue(&ctx);
 }
 
-enum jjson_error jjson__parse_json_value(jjson__parser *p, jjson_value *val)
+enum jjson_error jjson__plan_build(jjson__stringify_plan *plan, const jjson_t *obj, short depth, unsigned flags, size_t n_threads)
 {
-  enum jjson_error err = JJE_OK;
-  switch (p->curr_token.type)
+  memset(plan, 0, sizeof(*plan));
+  plan->tab_rate = depth;
+  plan->flags = flags;
+  // a few chunks per thread evens out fields of very different sizes
+  plan->chunks = n_threads * 4;
+
+  // the root is printed like an object value one level above its fields
+  jjson_value root;
+  root.type = JJSON_OBJECT;
+  root.data.object = (jjson_t *)obj;
+  size_t weight = jjson__plan_weight(&root, plan->chunks * JJSON__PARALLEL_MAX_VALUES);
+  plan->grain = MAX(weight / plan->chunks, (size_t)JJSON__PARALLEL_MIN_VALUES);
+  return jjson__plan_value(plan, &root, 0);
+}
+
+void jjson__plan_free(jjson__stringify_plan *plan)
+{
+  for (size_t i = 0; i < plan->count; ++i)
   {
-  case JJSON__TOKEN_NUMBER:
-    val->type = JJSON_NUMBER;
-    val->data.number = p->curr_token.label.number;
-    break;
-  case JJSON__TOKEN_STRING:
-    val->type = JJSON_STRING;
-    val->data.string = p->curr_token.label.string;
-    break;
-  case JJSON__TOKEN_LPAREN:
-    val->type = JJSON_ARRAY;
-    err = jjson_init_array(&val->data.array);
-    if (JJE_OK != err)
-      return err;
-    err = jjson__parse_json_array(p, &val->data.array);
-    if (JJE_OK != err)
-      return err;
-    break;
-  case JJSON__TOKEN_LBRACE:
-    val->type = JJSON_OBJECT;
-    val->data.object = (jjson_t *)malloc(sizeof(jjson_t));
-    err = jjson_init(val->data.object);
-    if (JJE_OK != err)
-      return err;
-    err = jjson__parse_json_object(p, val->data.object);
-    if (JJE_OK != err)
-      return err;
-    break;
-  case JJSON__TOKEN_NULL:
-    val->type = JJSON_NULL;
-    break;
-  case JJSON__TOKEN_TRUE:
-    val->type = JJSON_BOOLEAN;
-    val->data.boolean = JJSON_TRUE;
-    break;
-  case JJSON__TOKEN_FALSE:
-    val->type = JJSON_BOOLEAN;
-    val->data.boolean = JJSON_FALSE;
-    break;
-  default:
-    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Unsupported JSON value at %lu:%lu", p->curr_token.pos.line, p->curr_token.pos.colm);
-    return JJE_INVALID_TKN;
+    free(plan->tasks[i].text);
+  }
+  free(plan->tasks);
+}
+
+void *jjson__stringify_worker(void *arg)
+{
+  jjson__stringify_plan *plan = (jjson__stringify_plan *)arg;
+  while (1)
+  {
+    size_t index = __atomic_fetch_add(&plan->next, 1, __ATOMIC_RELAXED);
+    if (index >= plan->count)
+      break;
+    jjson__stringify_task *task = &plan->tasks[index];
+    if (!task->obj && !task->arr)
+      continue;
+    jjson__stringfier ctx;
+    ctx.tab = task->tab;
+    ctx.tab_rate = plan->tab_rate;
+    ctx.flags = plan->flags;
+    ctx.stream = open_memstream(&task->text, &task->text_len);
+    if (!ctx.stream)
+    {
+      jjson__plan_fail(plan);
+      continue;
+    }
+    if (task->obj)
+      jjson__stringify_object_fields(&ctx, task->obj, task->begin, task->end);
+    else
+      jjson__stringify_array_items(&ctx, task->arr, task->begin, task->end);
+    if (fclose(ctx.stream) != 0)
+      jjson__plan_fail(plan);
+  }
+  return NULL;
+}
+
+enum jjson_error jjson__stringify_run(jjson__stringify_plan *plan, const jjson_t *obj, short depth, unsigned flags, size_t n_threads)
+{
+  if (n_threads == 0)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n_threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  enum jjson_error err = jjson__plan_build(plan, obj, depth, flags, n_threads);
+  if (JJE_OK != err)
+  {
+    jjson__plan_free(plan);
+    return err;
+  }
+  pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * n_threads);
+  size_t started = 0;
+  for (; threads && started + 1 < n_threads; ++started)
+  {
+    if (pthread_create(&threads[started], NULL, jjson__stringify_worker, plan) != 0)
+      break;
+  }
+  // the calling thread works too
+  jjson__stringify_worker(plan);
+  for (size_t i = 0; i < started; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  if (JJE_OK != plan->error)
+  {
+    jjson__plan_free(plan);
+    return jjson__plan_out_of_memory();
   }
-  return jjson__parser_bump(p);
-}
-
-enum jjson_error jjson_init_array(jjson_array *arr)
-{
-  arr->length = 0;
-  arr->capacity = JSON_CAPACITY_INCR_RATE;
-  arr->items = (jjson_value *)malloc(sizeof(jjson_t) * JSON_CAPACITY_INCR_RATE);
-  // TODO: check malloc result
   return JJE_OK;
 }
 
-enum jjson_error jjson_array_push(jjson_array *array, jjson_value val)
+/*
+ * Same output as jjson_stringify_ex, but `obj` is cut into pieces of similar
+ * size, down to runs of fields or items inside its large arrays and objects
+ * at any depth, serialized on `n_threads` threads (0 for one per online CPU)
+ * and concatenated in order.
+ */
+enum jjson_error jjson_stringify_parallel(const jjson_t *obj, short depth, unsigned flags, size_t n_threads, char **out)
 {
-  if (array->capacity >= array->length)
+  jjson__stringify_plan plan;
+  enum jjson_error err = jjson__stringify_run(&plan, obj, depth, flags, n_threads);
+  if (JJE_OK != err)
+    return err;
+  size_t total = 0;
+  for (size_t i = 0; i < plan.count; ++i)
   {
-    size_t new_cap = array->capacity + JSON_CAPACITY_INCR_RATE;
-    array->items = (jjson_value *)realloc(array->items, sizeof(jjson_value) * new_cap);
-    // TODO: check malloc result
-    array->capacity = new_cap;
+    total += plan.tasks[i].text_len;
   }
-  array->items[array->length++] = val;
+  *out = (char *)malloc(total + 1);
+  if (!*out)
+  {
+    jjson__plan_free(&plan);
+    return JJE_ALLOC_FAIL;
+  }
+  size_t written = 0;
+  for (size_t i = 0; i < plan.count; ++i)
+  {
+    memcpy(*out + written, plan.tasks[i].text, plan.tasks[i].text_len);
+    written += plan.tasks[i].text_len;
+  }
+  (*out)[written] = '\0';
+  jjson__plan_free(&plan);
   return JJE_OK;
 }
 
-enum jjson_error jjson__parse_json_array(jjson__parser *p, jjson_array *arr)
+// Like jjson_stringify_parallel but hands the pieces to writev instead of joining them
+enum jjson_error jjson_write_parallel(const jjson_t *obj, short depth, unsigned flags, size_t n_threads, int fd)
 {
-  enum jjson_error err = JJE_OK;
-  err = jjson__parser_expect(p, JJSON__TOKEN_LPAREN);
+  jjson__stringify_plan plan;
+  enum jjson_error err = jjson__stringify_run(&plan, obj, depth, flags, n_threads);
   if (JJE_OK != err)
     return err;
-  while (p->curr_token.type != JJSON__TOKEN_EOF && p->curr_token.type != JJSON__TOKEN_RPAREN)
+  struct iovec iov[64];
+  size_t i = 0;
+  size_t offset = 0;
+  while (i < plan.count && JJE_OK == err)
   {
-    jjson_value val;
-    err = jjson__parse_json_value(p, &val);
-    if (JJE_OK != err)
-      return err;
-    err = jjson_array_push(arr, val);
-    if (JJE_OK != err)
-      return err;
-    if (p->curr_token.type == JJSON__TOKEN_RPAREN)
+    int iov_count = 0;
+    for (size_t k = i; k < plan.count && iov_count < 64; ++k)
     {
-      break;
+      size_t skip = k == i ? offset : 0;
+      iov[iov_count].iov_base = plan.tasks[k].text + skip;
+      iov[iov_count].iov_len = plan.tasks[k].text_len - skip;
+      iov_count += 1;
     }
-    if (p->curr_token.type == JJSON__TOKEN_COMMA)
+    ssize_t n = writev(fd, iov, iov_count);
+    if (n < 0)
     {
-      err = jjson__parser_bump(p);
-      if (JJE_OK != err)
-        return err;
+      if (errno == EINTR)
+        continue;
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Couldn't write output: %s", strerror(errno));
+      err = JJE_IO_FAIL;
+      break;
     }
-    else
+    // advance past whatever part of the batch was written
+    size_t left = (size_t)n;
+    while (i < plan.count && left >= plan.tasks[i].text_len - offset)
     {
-      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected ',' to separated Json Array items at "
-                                                                    "%lu:%lu",
-               p->curr_token.pos.line, p->curr_token.pos.colm);
-      return JJE_INVALID_TKN;
+      left -= plan.tasks[i].text_len - offset;
+      offset = 0;
+      i += 1;
     }
+    offset += left;
   }
+  jjson__plan_free(&plan);
   return err;
 }
 
-enum jjson_error jjson__parser_bump(jjson__parser *p)
+#endif // __linux__
+
+/**
+ * Batch File Ingestion
+ */
+
+#if defined(__linux__)
+
+#define JJSON__FILES_QUEUE_DEPTH 4
+#define JJSON__FILES_FIXED_BUF_SIZE (256 * 1024)
+
+typedef struct
 {
-  p->curr_token = p->next_token;
-  jjson__token tkn;
-  jjson__lexer_next_token(&p->lexer, &tkn);
-  switch (tkn.type)
-  {
-  case JJSON__TOKEN_INVALID:
-    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN - 1, "[JSON ERROR]: Invalid symbol '%c' at %lu:%lu", tkn.label.chr, tkn.pos.line, tkn.pos.colm);
-    return JJE_INVALID_TKN;
-  default:
-    p->next_token = tkn;
-    break;
-  }
-  return JJE_OK;
+  const char *const *paths;
+  size_t count;
+  size_t next;
+  unsigned flags;
+  jjson_file_callback callback;
+  void *user_data;
+} jjson__files_job;
+
+enum jjson__slot_state
+{
+  JJSON__SLOT_IDLE = 0,
+  JJSON__SLOT_READING,
+  JJSON__SLOT_READY,
+};
+
+typedef struct
+{
+  enum jjson__slot_state state;
+  size_t index;
+  int fd;
+  size_t size;
+  size_t done;
+  int fixed;
+  // registered with the ring, used for files that fit in it
+  char *fixed_buf;
+  // grown on demand for larger files and kept for the next ones
+  char *heap_buf;
+  size_t heap_cap;
+  struct iovec iov;
+} jjson__file_slot;
+
+int jjson__files_claim(jjson__files_job *job, size_t *index);
+enum jjson_error jjson__files_open(jjson__files_job *job, size_t index, int *fd, size_t *size);
+void jjson__files_deliver(jjson__files_job *job, jjson_t *json, size_t index, const char *content, size_t size);
+void jjson__files_fail(jjson__files_job *job, size_t index, enum jjson_error err);
+void *jjson__files_worker(void *arg);
+void jjson__files_read_pread(jjson__files_job *job, jjson_t *json, size_t index, char **buf, size_t *cap);
+void jjson__files_worker_pread(jjson__files_job *job, jjson_t *json);
+
+int jjson__files_claim(jjson__files_job *job, size_t *index)
+{
+  *index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+  return *index < job->count;
 }
 
-enum jjson_error jjson__parser_expect(jjson__parser *p, jjson__tkn_type tt)
+enum jjson_error jjson__files_open(jjson__files_job *job, size_t index, int *fd, size_t *size)
 {
-  if (p->curr_token.type != tt)
+  struct stat st;
+  *fd = open(job->paths[index], O_RDONLY | O_CLOEXEC);
+  if (*fd < 0 || fstat(*fd, &st) != 0)
   {
-    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Expected '%s' but got '%s' at %lu:%lu", JJSON__TOKEN_TYPE(tt), JJSON__TOKEN_TYPE(p->curr_token.type), p->curr_token.pos.line, p->curr_token.pos.colm);
-    return JJE_INVALID_TKN;
+    snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Couldn't open %s: %s", job->paths[index], strerror(errno));
+    if (*fd >= 0)
+      close(*fd);
+    return JJE_IO_FAIL;
   }
-  return jjson__parser_bump(p);
+  *size = (size_t)st.st_size;
+  return JJE_OK;
 }
 
-/**
- * JSON Stringifier
- */
-
-void jjson__stringify_json_object(jjson__stringfier *ctx, const jjson_t *obj);
-void jjson__stringify_json_value(jjson__stringfier *ctx, jjson_value val);
-void jjson__stringify_json_array(jjson__stringfier *ctx, jjson_array arr);
-void jjson__stringfier_print_tab(jjson__stringfier *ctx);
+// `json` is the worker's document, reset after every file so its memory is reused
+void jjson__files_deliver(jjson__files_job *job, jjson_t *json, size_t index, const char *content, size_t size)
+{
+  enum jjson_error err = jjson_parse_ex(json, content, size, job->flags);
+  job->callback(index, job->paths[index], JJE_OK == err ? json : NULL, err, job->user_data);
+  jjson_reset(json);
+}
 
-enum jjson_error jjson_stringify(const jjson_t *obj, short depth, char **out)
+void jjson__files_fail(jjson__files_job *job, size_t index, enum jjson_error err)
 {
-  unsigned long buf_len = 0;
-  jjson__stringfier ctx;
-  ctx.tab = depth;
-  ctx.tab_rate = depth;
-  ctx.stream = open_memstream(out, &buf_len);
-  jjson__stringify_json_object(&ctx, obj);
-  fclose(ctx.stream);
-  return JJE_OK;
+  job->callback(index, job->paths[index], NULL, err, job->user_data);
 }
 
-void jjson__stringify_json_object(jjson__stringfier *ctx, const jjson_t *obj)
+// Reads file `index` with blocking reads into `*buf`, grown as needed, and parses it
+void jjson__files_read_pread(jjson__files_job *job, jjson_t *json, size_t index, char **buf, size_t *cap)
 {
-  fprintf(ctx->stream, "{\n");
-  for (unsigned long i = 0; i < obj->field_count; ++i)
+  int fd;
+  size_t size;
+  enum jjson_error err = jjson__files_open(job, index, &fd, &size);
+  if (JJE_OK != err)
   {
-    jjson__stringfier_print_tab(ctx);
-    fprintf(ctx->stream, "\"%s\": ", obj->fields[i].key);
-    jjson__stringify_json_value(ctx, obj->fields[i].value);
-    if (i + 1 < obj->field_count)
+    jjson__files_fail(job, index, err);
+    return;
+  }
+  if (*cap < size + 1)
+  {
+    char *grown = (char *)realloc(*buf, size + 1);
+    if (!grown)
     {
-      fprintf(ctx->stream, ",");
+      close(fd);
+      snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Out of memory reading %s", job->paths[index]);
+      jjson__files_fail(job, index, JJE_ALLOC_FAIL);
+      return;
     }
-    fprintf(ctx->stream, "\n");
+    *buf = grown;
+    *cap = size + 1;
   }
-  ctx->tab == ctx->tab_rate ? fprintf(ctx->stream, "}\n") : ({
-    ctx->tab -= ctx->tab_rate;
-    jjson__stringfier_print_tab(ctx);
-    fprintf(ctx->stream, "}");
-    ctx->tab += ctx->tab_rate;
-  });
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t n = pread(fd, *buf + done, size - done, done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  close(fd);
+  (*buf)[done] = '\0';
+  jjson__files_deliver(job, json, index, *buf, done);
 }
 
-void jjson__stringify_json_value(jjson__stringfier *ctx, jjson_value val)
+// Fallback for kernels (or sandboxes) without io_uring: blocking reads, one file at a time per worker
+void jjson__files_worker_pread(jjson__files_job *job, jjson_t *json)
 {
-  switch (val.type)
+  char *buf = NULL;
+  size_t cap = 0;
+  size_t index;
+  while (jjson__files_claim(job, &index))
   {
-  case JJSON_NUMBER:
-    fprintf(ctx->stream, "%lld", val.data.number);
-    return;
-  case JJSON_STRING:
-    fprintf(ctx->stream, "\"%s\"", val.data.string);
-    return;
-  case JJSON_ARRAY:
-    jjson__stringify_json_array(ctx, val.data.array);
-    return;
-  case JJSON_OBJECT:
-    ctx->tab += ctx->tab_rate;
-    jjson__stringify_json_object(ctx, val.data.object);
-    ctx->tab -= ctx->tab_rate;
-    return;
-  case JJSON_NULL:
-    fprintf(ctx->stream, "null");
-    return;
-  case JJSON_BOOLEAN:
-    if (val.data.boolean)
-    {
-      fprintf(ctx->stream, "true");
-    }
-    else
-    {
-      fprintf(ctx->stream, "false");
-    }
-    return;
+    jjson__files_read_pread(job, json, index, &buf, &cap);
   }
+  free(buf);
 }
 
-void jjson__stringify_json_array(jjson__stringfier *ctx, jjson_array arr)
+#if defined(JJSON__IO_URING)
+
+typedef struct
 {
-  fprintf(ctx->stream, "[");
-  ctx->tab += ctx->tab_rate;
-  for (int i = 0; i < arr.length; ++i)
+  int fd;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr;
+  size_t sq_len;
+  void *cq_ptr;
+  size_t cq_len;
+  size_t sqes_len;
+  unsigned pending;
+} jjson__uring;
+
+int jjson__uring_init(jjson__uring *ring, unsigned entries);
+void jjson__uring_deinit(jjson__uring *ring);
+int jjson__uring_enter(jjson__uring *ring, unsigned wait_nr);
+void jjson__uring_submit_read(jjson__uring *ring, jjson__file_slot *slot, unsigned slot_index, int fixed);
+int jjson__files_worker_uring(jjson__files_job *job, jjson_t *json);
+
+int jjson__uring_init(jjson__uring *ring, unsigned entries)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return -1;
+
+  ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    ring->sq_len = ring->cq_len = MAX(ring->sq_len, ring->cq_len);
+  ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED)
   {
-    fprintf(ctx->stream, "\n");
-    jjson__stringfier_print_tab(ctx);
-    jjson__stringify_json_value(ctx, arr.items[i]);
-    if (i + 1 < arr.length)
+    close(ring->fd);
+    return -1;
+  }
+  ring->cq_ptr = ring->sq_ptr;
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+  {
+    ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED)
     {
-      fprintf(ctx->stream, ",");
+      munmap(ring->sq_ptr, ring->sq_len);
+      close(ring->fd);
+      return -1;
     }
   }
-  ctx->tab -= ctx->tab_rate;
-  fprintf(ctx->stream, "\n");
-  jjson__stringfier_print_tab(ctx);
-  fprintf(ctx->stream, "]");
+  ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+  {
+    if (ring->cq_ptr != ring->sq_ptr)
+      munmap(ring->cq_ptr, ring->cq_len);
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+    return -1;
+  }
+
+  char *sq = (char *)ring->sq_ptr;
+  char *cq = (char *)ring->cq_ptr;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return 0;
 }
 
-void jjson__stringfier_print_tab(jjson__stringfier *ctx)
+void jjson__uring_deinit(jjson__uring *ring)
 {
-  for (unsigned long i = 0; i < ctx->tab; ++i)
-  {
-    fprintf(ctx->stream, " ");
-  }
+  munmap(ring->sqes, ring->sqes_len);
+  if (ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_len);
+  munmap(ring->sq_ptr, ring->sq_len);
+  close(ring->fd);
 }
 
-void jjson_dump(const jjson_t *json, FILE *f, int depth)
+int jjson__uring_enter(jjson__uring *ring, unsigned wait_nr)
 {
-  char *buf;
-  jjson_stringify(json, depth, &buf);
-  fprintf(f, "%s", buf);
-  free(buf);
+  while (1)
+  {
+    int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (ret >= 0)
+    {
+      ring->pending -= MIN((unsigned)ret, ring->pending);
+      return 0;
+    }
+    if (errno != EINTR)
+      return -1;
+  }
 }
 
-enum jjson_error jjson_deinit(jjson_t *json)
+void jjson__uring_submit_read(jjson__uring *ring, jjson__file_slot *slot, unsigned slot_index, int fixed)
 {
-  return jjson_deinit_object(json);
+  unsigned tail = *ring->sq_tail;
+  unsigned idx = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = slot->fd;
+  sqe->off = slot->done;
+  sqe->user_data = slot_index;
+  if (fixed)
+  {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->addr = (unsigned long long)(uintptr_t)(slot->fixed_buf + slot->done);
+    sqe->len = (unsigned)(slot->size - slot->done);
+    sqe->buf_index = (unsigned short)slot_index;
+  }
+  else
+  {
+    slot->iov.iov_base = slot->heap_buf + slot->done;
+    slot->iov.iov_len = slot->size - slot->done;
+    sqe->opcode = IORING_OP_READV;
+    sqe->addr = (unsigned long long)(uintptr_t)&slot->iov;
+    sqe->len = 1;
+  }
+  ring->sq_array[idx] = idx;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->pending += 1;
 }
 
-enum jjson_error jjson_deinit_object(jjson_t *json)
+/*
+ * Keeps up to JJSON__FILES_QUEUE_DEPTH reads in flight on a private ring and
+ * parses whichever file lands first while the kernel fills the others.
+ * Returns non-zero when the ring could not be set up or stopped working; the
+ * files it had claimed are still delivered, the rest are left to the caller.
+ */
+int jjson__files_worker_uring(jjson__files_job *job, jjson_t *json)
 {
-  enum jjson_error err = JJE_OK;
-  for (int i = 0; i < json->field_count; ++i)
+  jjson__uring ring;
+  if (jjson__uring_init(&ring, JJSON__FILES_QUEUE_DEPTH) != 0)
+    return -1;
+
+  jjson__file_slot slots[JJSON__FILES_QUEUE_DEPTH];
+  struct iovec fixed_iovs[JJSON__FILES_QUEUE_DEPTH];
+  memset(slots, 0, sizeof(slots));
+  int allocated = 1;
+  for (unsigned i = 0; i < JJSON__FILES_QUEUE_DEPTH; ++i)
   {
-    jjson_key_value *kv = &json->fields[i];
-    free((void *)kv->key);
-    err = jjson_deinit_value(&kv->value);
-    if (JJE_OK != err)
+    slots[i].fixed_buf = (char *)malloc(JJSON__FILES_FIXED_BUF_SIZE);
+    allocated = allocated && slots[i].fixed_buf;
+    fixed_iovs[i].iov_base = slots[i].fixed_buf;
+    fixed_iovs[i].iov_len = JJSON__FILES_FIXED_BUF_SIZE;
+  }
+  // registration pins the buffers once instead of on every read; it fails
+  // under a low RLIMIT_MEMLOCK, in which case plain reads are used
+  int registered = allocated && syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, fixed_iovs, JJSON__FILES_QUEUE_DEPTH) == 0;
+
+  int exhausted = 0;
+  int failed = 0;
+  unsigned busy = 0;
+  while (1)
+  {
+    for (unsigned i = 0; i < JJSON__FILES_QUEUE_DEPTH && !exhausted; ++i)
     {
-      return err;
+      jjson__file_slot *slot = &slots[i];
+      while (slot->state == JJSON__SLOT_IDLE)
+      {
+        if (!jjson__files_claim(job, &slot->index))
+        {
+          exhausted = 1;
+          break;
+        }
+        enum jjson_error err = jjson__files_open(job, slot->index, &slot->fd, &slot->size);
+        if (JJE_OK != err)
+        {
+          jjson__files_fail(job, slot->index, err);
+          continue;
+        }
+        slot->done = 0;
+        slot->fixed = registered && slot->size < JJSON__FILES_FIXED_BUF_SIZE;
+        if (!slot->fixed && slot->heap_cap < slot->size + 1)
+        {
+          char *grown = (char *)realloc(slot->heap_buf, slot->size + 1);
+          if (!grown)
+          {
+            close(slot->fd);
+            snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Out of memory reading %s", job->paths[slot->index]);
+            jjson__files_fail(job, slot->index, JJE_ALLOC_FAIL);
+            continue;
+          }
+          slot->heap_buf = grown;
+          slot->heap_cap = slot->size + 1;
+        }
+        busy += 1;
+        if (slot->size == 0)
+        {
+          slot->state = JJSON__SLOT_READY;
+          break;
+        }
+        slot->state = JJSON__SLOT_READING;
+        jjson__uring_submit_read(&ring, slot, i, slot->fixed);
+      }
+    }
+    if (busy == 0)
+      break;
+
+    jjson__file_slot *ready = NULL;
+    for (unsigned i = 0; i < JJSON__FILES_QUEUE_DEPTH && !ready; ++i)
+    {
+      if (slots[i].state == JJSON__SLOT_READY)
+        ready = &slots[i];
+    }
+    if ((!ready || ring.pending) && jjson__uring_enter(&ring, ready ? 0 : 1) != 0)
+    {
+      failed = 1;
+      break;
+    }
+
+    unsigned head = *ring.cq_head;
+    while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+    {
+      struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+      unsigned slot_index = (unsigned)cqe->user_data;
+      jjson__file_slot *slot = &slots[slot_index];
+      if (cqe->res < 0)
+      {
+        snprintf(jjson__last_error_message, JJSON__ERROR_MSG_MAX_LEN, "[JSON ERROR]: Couldn't read %s: %s", job->paths[slot->index], strerror(-cqe->res));
+        close(slot->fd);
+        jjson__files_fail(job, slot->index, JJE_IO_FAIL);
+        slot->state = JJSON__SLOT_IDLE;
+        busy -= 1;
+      }
+      else if (cqe->res == 0 || slot->done + cqe->res >= slot->size)
+      {
+        // a file that shrank since fstat ends at the short read
+        slot->done += cqe->res;
+        slot->state = JJSON__SLOT_READY;
+      }
+      else
+      {
+        slot->done += cqe->res;
+        jjson__uring_submit_read(&ring, slot, slot_index, slot->fixed);
+      }
+      head += 1;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+    for (unsigned i = 0; i < JJSON__FILES_QUEUE_DEPTH; ++i)
+    {
+      jjson__file_slot *slot = &slots[i];
+      if (slot->state != JJSON__SLOT_READY)
+        continue;
+      // push the reads queued above to the kernel before spending time parsing
+      if (ring.pending)
+        jjson__uring_enter(&ring, 0);
+      char *content = slot->fixed ? slot->fixed_buf : slot->heap_buf;
+      close(slot->fd);
+      content[slot->done] = '\0';
+      jjson__files_deliver(job, json, slot->index, content, slot->done);
+      slot->state = JJSON__SLOT_IDLE;
+      busy -= 1;
+      break;
     }
   }
-  free(json->fields);
-  return JJE_OK;
-}
 
-enum jjson_error jjson_deinit_array(jjson_array *arr)
-{
-  enum jjson_error err = JJE_OK;
-  for (int i = 0; i < arr->length; ++i)
+  jjson__uring_deinit(&ring);
+
+  // only reached with busy slots when the ring failed
+  char *buf = NULL;
+  size_t cap = 0;
+  for (unsigned i = 0; i < JJSON__FILES_QUEUE_DEPTH; ++i)
   {
-    err = jjson_deinit_value(&arr->items[i]);
-    if (JJE_OK != err)
+    jjson__file_slot *slot = &slots[i];
+    if (slot->state == JJSON__SLOT_READY)
     {
-      return err;
+      char *content = slot->fixed ? slot->fixed_buf : slot->heap_buf;
+      close(slot->fd);
+      content[slot->done] = '\0';
+      jjson__files_deliver(job, json, slot->index, content, slot->done);
+    }
+    else if (slot->state == JJSON__SLOT_READING)
+    {
+      // the kernel may still write into this slot's buffers after the ring
+      // is closed, so they are leaked rather than freed and the file is read again
+      close(slot->fd);
+      jjson__files_read_pread(job, json, slot->index, &buf, &cap);
+      continue;
     }
+    free(slot->fixed_buf);
+    free(slot->heap_buf);
   }
-  free(arr->items);
-  return err;
+  free(buf);
+  return failed ? -1 : 0;
 }
+#endif // JJSON__IO_URING
 
-enum jjson_error jjson_deinit_value(jjson_value *val)
+void *jjson__files_worker(void *arg)
 {
-  enum jjson_error err = JJE_OK;
-  switch (val->type)
+  jjson__files_job *job = (jjson__files_job *)arg;
+  jjson_t json;
+  jjson_init(&json);
+#if defined(JJSON__IO_URING)
+  if (jjson__files_worker_uring(job, &json) != 0)
+    jjson__files_worker_pread(job, &json);
+#else
+  jjson__files_worker_pread(job, &json);
+#endif
+  jjson_deinit(&json);
+  return NULL;
+}
+
+/*
+ * Reads and parses `paths` on `n_threads` workers (0 picks one per online
+ * CPU), calling `callback` for every file in completion order. Each worker
+ * reads through its own io_uring when the kernel allows it and falls back to
+ * pread otherwise.
+ */
+enum jjson_error jjson_parse_files(const char *const *paths, size_t count, size_t n_threads, unsigned flags, jjson_file_callback callback, void *user_data)
+{
+  jjson__files_job job = {paths, count, 0, flags, callback, user_data};
+  if (n_threads == 0)
   {
-  case JJSON_STRING:
-    free(val->data.string);
-    break;
-  case JJSON_OBJECT:
-    err = jjson_deinit_object(val->data.object);
-    free(val->data.object);
-    break;
-  case JJSON_ARRAY:
-    err = jjson_deinit_array(&val->data.array);
-    break;
-  default:
-    break;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n_threads = cpus > 0 ? (size_t)cpus : 1;
   }
-  return err;
+  n_threads = MIN(n_threads, MAX(count, (size_t)1));
+
+  pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * n_threads);
+  if (!threads)
+    return JJE_ALLOC_FAIL;
+  size_t started = 0;
+  for (; started < n_threads; ++started)
+  {
+    if (pthread_create(&threads[started], NULL, jjson__files_worker, &job) != 0)
+      break;
+  }
+  if (started == 0)
+  {
+    // no threads available, do the work on the caller's thread
+    jjson__files_worker(&job);
+  }
+  for (size_t i = 0; i < started; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  return JJE_OK;
 }
+
+#endif // __linux__
 #endif // JACK_IMPLEMENTATION
 
 #endif // __JACK_JSON_PARSER__
@@ -0,0 +1,493 @@
+#ifndef __JACK_JSON_PARSER_HPP__
+#define __JACK_JSON_PARSER_HPP__
+
+/*
+ * C++17 wrapper over jack.h. Include it after defining JACK_IMPLEMENTATION in
+ * exactly one translation unit, as with the C header.
+ *
+ * `Document` owns a parsed `jjson_t` and is move-only. `Value`, `Object` and
+ * `Array` are non-owning views into a document and stay valid until it is
+ * destroyed, reparsed or modified; strings and keys are returned as
+ * `std::string_view` over the document's own buffers, so nothing is copied.
+ * Errors are reported by throwing `jack::Error`.
+ */
+
+#include "jack.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace jack
+{
+
+class Object;
+class Array;
+
+class Error : public std::runtime_error
+{
+public:
+  Error(jjson_error code, const char *what) : std::runtime_error(what), code_(code) {}
+
+  jjson_error code() const noexcept { return code_; }
+
+private:
+  jjson_error code_;
+};
+
+// Selects the Document::parse overloads that read the caller's text in place
+struct borrow_t
+{
+  explicit borrow_t() = default;
+};
+inline constexpr borrow_t borrow{};
+
+namespace detail
+{
+
+template <typename T>
+inline constexpr bool always_false = false;
+
+[[noreturn]] inline void fail(jjson_error err)
+{
+  switch (err)
+  {
+  case JJE_NOT_FOUND:
+    throw Error(err, "[JSON ERROR]: Key not found");
+  case JJE_TYPE_MISMATCH:
+    throw Error(err, "[JSON ERROR]: Json value has a different type");
+  case JJE_OUT_OF_RANGE:
+    throw Error(err, "[JSON ERROR]: Json number is out of range");
+  case JJE_ALLOC_FAIL:
+    throw std::bad_alloc();
+  default:
+    throw Error(err, jjson_strerror());
+  }
+}
+
+inline void check(jjson_error err)
+{
+  if (err != JJE_OK)
+    fail(err);
+}
+
+// compares a NUL-terminated key without measuring it first
+inline bool key_equals(const char *key, std::string_view wanted) noexcept
+{
+  return std::strncmp(key, wanted.data(), wanted.size()) == 0 && key[wanted.size()] == '\0';
+}
+
+} // namespace detail
+
+class Value
+{
+public:
+  Value() noexcept = default;
+  explicit Value(jjson_value *val) noexcept : val_(val) {}
+
+  // false for the empty view returned by Object::find on a missing key
+  explicit operator bool() const noexcept { return val_ != nullptr; }
+
+  jjson_type type() const noexcept { return val_->type; }
+  bool is_null() const noexcept { return val_->type == JJSON_NULL; }
+
+  template <typename T>
+  bool is() const noexcept;
+
+  // Converts to `T`: bool, any integral or floating point type,
+  // std::string_view, Object or Array. Throws Error on a type mismatch or
+  // when an integer does not fit `T`.
+  template <typename T>
+  T get() const;
+
+  // source text of a JJSON_RAW_NUMBER
+  std::string_view raw() const
+  {
+    expect(JJSON_RAW_NUMBER);
+    return std::string_view(val_->data.raw_number.text, val_->data.raw_number.length);
+  }
+
+  jjson_value *c_value() const noexcept { return val_; }
+
+private:
+  void expect(jjson_type type) const
+  {
+    if (val_->type != type)
+      detail::fail(JJE_TYPE_MISMATCH);
+  }
+
+  jjson_value *val_ = nullptr;
+};
+
+struct Member
+{
+  std::string_view key;
+  Value value;
+};
+
+class Object
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Member;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Member;
+
+    explicit iterator(jjson_key_value *kv) noexcept : kv_(kv) {}
+
+    Member operator*() const noexcept { return Member{kv_->key, Value(&kv_->value)}; }
+    iterator &operator++() noexcept
+    {
+      ++kv_;
+      return *this;
+    }
+    iterator operator++(int) noexcept
+    {
+      iterator prev = *this;
+      ++kv_;
+      return prev;
+    }
+    bool operator==(const iterator &other) const noexcept { return kv_ == other.kv_; }
+    bool operator!=(const iterator &other) const noexcept { return kv_ != other.kv_; }
+
+  private:
+    jjson_key_value *kv_;
+  };
+
+  explicit Object(jjson_t *obj) noexcept : obj_(obj) {}
+
+  std::size_t size() const noexcept { return obj_->field_count; }
+  bool empty() const noexcept { return obj_->field_count == 0; }
+  iterator begin() const noexcept { return iterator(obj_->fields); }
+  iterator end() const noexcept { return iterator(obj_->fields + obj_->field_count); }
+
+  // empty Value when `key` is missing
+  Value find(std::string_view key) const noexcept
+  {
+    for (std::size_t i = 0; i < obj_->field_count; ++i)
+    {
+      if (detail::key_equals(obj_->fields[i].key, key))
+        return Value(&obj_->fields[i].value);
+    }
+    return Value();
+  }
+
+  bool contains(std::string_view key) const noexcept { return static_cast<bool>(find(key)); }
+
+  // throws Error(JJE_NOT_FOUND) when `key` is missing
+  Value operator[](std::string_view key) const
+  {
+    Value val = find(key);
+    if (!val)
+      detail::fail(JJE_NOT_FOUND);
+    return val;
+  }
+
+  jjson_t *c_object() const noexcept { return obj_; }
+
+private:
+  jjson_t *obj_;
+};
+
+class Array
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Value;
+
+    explicit iterator(jjson_value *item) noexcept : item_(item) {}
+
+    Value operator*() const noexcept { return Value(item_); }
+    iterator &operator++() noexcept
+    {
+      ++item_;
+      return *this;
+    }
+    iterator operator++(int) noexcept
+    {
+      iterator prev = *this;
+      ++item_;
+      return prev;
+    }
+    bool operator==(const iterator &other) const noexcept { return item_ == other.item_; }
+    bool operator!=(const iterator &other) const noexcept { return item_ != other.item_; }
+
+  private:
+    jjson_value *item_;
+  };
+
+  explicit Array(jjson_array *arr) noexcept : arr_(arr) {}
+
+  std::size_t size() const noexcept { return arr_->length; }
+  bool empty() const noexcept { return arr_->length == 0; }
+  iterator begin() const noexcept { return iterator(arr_->items); }
+  iterator end() const noexcept { return iterator(arr_->items + arr_->length); }
+
+  // unchecked, like std::vector
+  Value operator[](std::size_t i) const noexcept { return Value(&arr_->items[i]); }
+
+  // throws Error(JJE_OUT_OF_RANGE) past the end
+  Value at(std::size_t i) const
+  {
+    if (i >= arr_->length)
+      detail::fail(JJE_OUT_OF_RANGE);
+    return Value(&arr_->items[i]);
+  }
+
+  jjson_array *c_array() const noexcept { return arr_; }
+
+private:
+  jjson_array *arr_;
+};
+
+template <typename T>
+bool Value::is() const noexcept
+{
+  using U = std::remove_cv_t<T>;
+  if constexpr (std::is_same_v<U, bool>)
+    return val_->type == JJSON_BOOLEAN;
+  else if constexpr (std::is_integral_v<U>)
+  {
+    // plain numbers are always integers, raw ones only without fraction or exponent
+    if (val_->type != JJSON_RAW_NUMBER)
+      return val_->type == JJSON_NUMBER;
+    std::string_view text(val_->data.raw_number.text, val_->data.raw_number.length);
+    return text.find_first_of(".eE") == std::string_view::npos;
+  }
+  else if constexpr (std::is_floating_point_v<U>)
+    return val_->type == JJSON_NUMBER || val_->type == JJSON_RAW_NUMBER;
+  else if constexpr (std::is_same_v<U, std::string_view>)
+    return val_->type == JJSON_STRING;
+  else if constexpr (std::is_same_v<U, Object>)
+    return val_->type == JJSON_OBJECT;
+  else if constexpr (std::is_same_v<U, Array>)
+    return val_->type == JJSON_ARRAY;
+  else
+    static_assert(detail::always_false<T>, "jack::Value::is<T>: unsupported type");
+}
+
+template <typename T>
+T Value::get() const
+{
+  using U = std::remove_cv_t<T>;
+  if constexpr (std::is_same_v<U, bool>)
+  {
+    expect(JJSON_BOOLEAN);
+    return val_->data.boolean == JJSON_TRUE;
+  }
+  else if constexpr (std::is_integral_v<U>)
+  {
+    long long n;
+    detail::check(jjson_value_int64(val_, &n));
+    if constexpr (std::is_signed_v<U>)
+    {
+      if (n < static_cast<long long>(std::numeric_limits<U>::min()) || n > static_cast<long long>(std::numeric_limits<U>::max()))
+        detail::fail(JJE_OUT_OF_RANGE);
+    }
+    else
+    {
+      if (n < 0 || static_cast<unsigned long long>(n) > std::numeric_limits<U>::max())
+        detail::fail(JJE_OUT_OF_RANGE);
+    }
+    return static_cast<U>(n);
+  }
+  else if constexpr (std::is_floating_point_v<U>)
+  {
+    double d;
+    detail::check(jjson_value_double(val_, &d));
+    return static_cast<U>(d);
+  }
+  else if constexpr (std::is_same_v<U, std::string_view>)
+  {
+    expect(JJSON_STRING);
+    return std::string_view(val_->data.string);
+  }
+  else if constexpr (std::is_same_v<U, Object>)
+  {
+    expect(JJSON_OBJECT);
+    return Object(val_->data.object);
+  }
+  else if constexpr (std::is_same_v<U, Array>)
+  {
+    expect(JJSON_ARRAY);
+    return Array(&val_->data.array);
+  }
+  else
+  {
+    static_assert(detail::always_false<T>, "jack::Value::get<T>: unsupported type");
+  }
+}
+
+// Owns the malloc'd text produced by jjson_stringify
+class String
+{
+public:
+  String() noexcept = default;
+  explicit String(char *text) noexcept : text_(text) {}
+  String(String &&other) noexcept : text_(std::exchange(other.text_, nullptr)) {}
+  String &operator=(String &&other) noexcept
+  {
+    std::swap(text_, other.text_);
+    return *this;
+  }
+  String(const String &) = delete;
+  String &operator=(const String &) = delete;
+  ~String() { std::free(text_); }
+
+  const char *c_str() const noexcept { return text_ ? text_ : ""; }
+  std::string_view view() const noexcept { return c_str(); }
+  operator std::string_view() const noexcept { return view(); }
+
+private:
+  char *text_ = nullptr;
+};
+
+class Document
+{
+public:
+  // throws std::bad_alloc when the empty document cannot be allocated
+  Document() { detail::check(jjson_init(&json_)); }
+
+  // the moved-from document is left empty and may be reparsed
+  Document(Document &&other) noexcept
+      : json_(std::exchange(other.json_, jjson_t{})),
+        source_(std::exchange(other.source_, nullptr)),
+        source_len_(std::exchange(other.source_len_, 0)),
+        source_mr_(other.source_mr_)
+  {
+  }
+
+  Document &operator=(Document &&other) noexcept
+  {
+    std::swap(json_, other.json_);
+    std::swap(source_, other.source_);
+    std::swap(source_len_, other.source_len_);
+    std::swap(source_mr_, other.source_mr_);
+    return *this;
+  }
+
+  Document(const Document &) = delete;
+  Document &operator=(const Document &) = delete;
+
+  ~Document()
+  {
+    jjson_deinit(&json_);
+    release_source();
+  }
+
+  /*
+   * Parses `text` into a new document. With JJSON_PARSE_RAW_NUMBERS the
+   * numbers point into the source, so the document keeps a copy of `text`
+   * allocated from `mr`; otherwise `text` is not retained.
+   */
+  static Document parse(std::string_view text, unsigned flags = JJSON_PARSE_DEFAULT, std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+  {
+    Document doc;
+    doc.source_mr_ = mr;
+    doc.parse_into(text, flags, true);
+    return doc;
+  }
+
+  /*
+   * Same as parse, but raw numbers point straight into `text` instead of a
+   * copy. The caller keeps `text` alive and unchanged while the document is
+   * used; prefer the copying overload unless the copy shows up in a profile.
+   */
+  static Document parse(borrow_t, std::string_view text, unsigned flags = JJSON_PARSE_DEFAULT)
+  {
+    Document doc;
+    doc.parse_into(text, flags, false);
+    return doc;
+  }
+
+  // Replaces the content, reusing the document's memory through jjson_reset
+  void reparse(std::string_view text, unsigned flags = JJSON_PARSE_DEFAULT)
+  {
+    detail::check(jjson_reset(&json_));
+    parse_into(text, flags, true);
+  }
+
+  void reparse(borrow_t, std::string_view text, unsigned flags = JJSON_PARSE_DEFAULT)
+  {
+    detail::check(jjson_reset(&json_));
+    parse_into(text, flags, false);
+  }
+
+  Object root() noexcept { return Object(&json_); }
+  Object::iterator begin() noexcept { return root().begin(); }
+  Object::iterator end() noexcept { return root().end(); }
+  Value find(std::string_view key) noexcept { return root().find(key); }
+  Value operator[](std::string_view key) { return root()[key]; }
+
+  String stringify(short depth = 1, unsigned flags = JJSON_STRINGIFY_DEFAULT) const
+  {
+    char *out = nullptr;
+    detail::check(jjson_stringify_ex(&json_, depth, flags, &out));
+    return String(out);
+  }
+
+  // same as stringify, copied once into a string allocated from `mr`
+  std::pmr::string stringify(std::pmr::memory_resource *mr, short depth = 1, unsigned flags = JJSON_STRINGIFY_DEFAULT) const
+  {
+    String text = stringify(depth, flags);
+    return std::pmr::string(text.view(), mr);
+  }
+
+  unsigned long long hash() const noexcept { return jjson_hash(&json_); }
+
+  friend bool operator==(const Document &a, const Document &b) noexcept { return jjson_equal(&a.json_, &b.json_) == JJSON_TRUE; }
+  friend bool operator!=(const Document &a, const Document &b) noexcept { return !(a == b); }
+
+  jjson_t *c_object() noexcept { return &json_; }
+  const jjson_t *c_object() const noexcept { return &json_; }
+
+private:
+  void parse_into(std::string_view text, unsigned flags, bool copy)
+  {
+    release_source();
+    if (copy && (flags & JJSON_PARSE_RAW_NUMBERS))
+    {
+      source_ = static_cast<char *>(source_mr_->allocate(text.size() + 1, alignof(char)));
+      source_len_ = text.size() + 1;
+      std::memcpy(source_, text.data(), text.size());
+      source_[text.size()] = '\0';
+      text = std::string_view(source_, text.size());
+    }
+    detail::check(jjson_parse_ex(&json_, text.data(), text.size(), flags));
+  }
+
+  void release_source() noexcept
+  {
+    if (source_)
+      source_mr_->deallocate(source_, source_len_, alignof(char));
+    source_ = nullptr;
+    source_len_ = 0;
+  }
+
+  jjson_t json_;
+  char *source_ = nullptr;
+  std::size_t source_len_ = 0;
+  std::pmr::memory_resource *source_mr_ = std::pmr::get_default_resource();
+};
+
+} // namespace jack
+
+#endif // __JACK_JSON_PARSER_HPP__
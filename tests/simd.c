@@ -0,0 +1,424 @@
+/*
+ * Checks the vector scanners in jack.h (string scanning and decoding, UTF-8
+ * validation, output escaping) against byte-at-a-time references on random
+ * and boundary inputs, and that jjson_scan finds the same values when its
+ * input arrives in pieces. Built once per instruction set by CMake; with
+ * JACK_NO_SIMD the library's own scalar paths are checked the same way.
+ */
+
+#define JACK_IMPLEMENTATION
+#include "jack.h"
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+static size_t failures = 0;
+
+static unsigned rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (unsigned)(rng_state >> 32);
+}
+
+// bytes that end runs, start escapes or sit on UTF-8 class edges
+static const unsigned char interesting[] = {
+    'a', 'z', ' ', '"', '\\', '/', 'u', 'n', 'D', '8', '0', 'E', 0x00, 0x01, 0x1F, 0x20, 0x7F,
+    0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xFF};
+
+static void fill_random(char *buf, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    unsigned r = rng();
+    // mostly plain ASCII so the vector loops get whole clean blocks
+    buf[i] = (char)(r % 4 ? 'a' + (r >> 8) % 26 : interesting[(r >> 8) % sizeof(interesting)]);
+  }
+}
+
+static void report(const char *what, const char *buf, size_t len, size_t expected, size_t got)
+{
+  failures += 1;
+  if (failures > 20)
+    return;
+  printf("%s mismatch: len %zu expected %zu got %zu:", what, len, expected, got);
+  for (size_t i = 0; i < len; ++i)
+    printf(" %02x", (unsigned char)buf[i]);
+  printf("\n");
+}
+
+/**
+ * References
+ */
+
+static size_t ref_validate_utf8(const char *s, size_t len)
+{
+  const unsigned char *u = (const unsigned char *)s;
+  size_t i = 0;
+  while (i < len)
+  {
+    unsigned char c = u[i];
+    size_t need;
+    unsigned long cp;
+    if (c < 0x80)
+    {
+      i += 1;
+      continue;
+    }
+    if ((c & 0xE0) == 0xC0)
+    {
+      need = 1;
+      cp = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+      need = 2;
+      cp = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+      need = 3;
+      cp = c & 0x07;
+    }
+    else
+      return i;
+    if (i + need >= len)
+      return i;
+    for (size_t k = 1; k <= need; ++k)
+    {
+      if ((u[i + k] & 0xC0) != 0x80)
+        return i;
+      cp = (cp << 6) | (u[i + k] & 0x3F);
+    }
+    static const unsigned long min_cp[] = {0, 0x80, 0x800, 0x10000};
+    if (cp < min_cp[need] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+      return i;
+    i += need + 1;
+  }
+  return len;
+}
+
+static size_t ref_scan_string_special(const char *s, size_t i, size_t len, unsigned *flags)
+{
+  for (; i < len; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\' || c < 0x20)
+      return i;
+    if (c >= 0x80)
+      *flags |= JJSON__STR_NON_ASCII;
+  }
+  return len;
+}
+
+// Closing quote of the string starting at `s[0]`, or `(size_t)-1` when it is malformed
+static size_t ref_scan_string(const char *s, size_t len)
+{
+  size_t i = 0;
+  while (i < len)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"')
+      return ref_validate_utf8(s, i) == i ? i : (size_t)-1;
+    if (c < 0x20)
+      return (size_t)-1;
+    if (c == '\\')
+    {
+      size_t consumed = jjson__decode_escape(s, i, len, NULL, NULL);
+      if (consumed == 0)
+        return (size_t)-1;
+      i += consumed;
+      continue;
+    }
+    i += 1;
+  }
+  return (size_t)-1;
+}
+
+static size_t ref_decode_string(const char *s, size_t end, char *out)
+{
+  size_t written = 0;
+  size_t i = 0;
+  while (i < end)
+  {
+    if (s[i] != '\\')
+    {
+      out[written++] = s[i++];
+      continue;
+    }
+    size_t out_len = 0;
+    i += jjson__decode_escape(s, i, end, out + written, &out_len);
+    written += out_len;
+  }
+  return written;
+}
+
+static size_t ref_needs_escape(const char *s, size_t i, size_t len, int ascii_only)
+{
+  for (; i < len; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\' || c < 0x20 || (ascii_only && c >= 0x80))
+      return i;
+  }
+  return len;
+}
+
+// What jjson__stringify_string writes without JJSON_STRINGIFY_ASCII
+static size_t ref_escape_string(const char *s, size_t len, char *out)
+{
+  size_t o = 0;
+  out[o++] = '"';
+  for (size_t i = 0; i < len; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    const char *short_escape = c == '"' ? "\\\"" : c == '\\' ? "\\\\" : c == '\b' ? "\\b" : c == '\f' ? "\\f" : c == '\n' ? "\\n" : c == '\r' ? "\\r" : c == '\t' ? "\\t" : NULL;
+    if (short_escape)
+    {
+      memcpy(out + o, short_escape, 2);
+      o += 2;
+    }
+    else if (c < 0x20)
+      o += (size_t)sprintf(out + o, "\\u%04x", c);
+    else
+      out[o++] = (char)c;
+  }
+  out[o++] = '"';
+  return o;
+}
+
+/**
+ * Checks
+ */
+
+static void check_utf8(const char *buf, size_t len)
+{
+  size_t expected = ref_validate_utf8(buf, len);
+  size_t got = jjson__validate_utf8(buf, len);
+  if (got != expected)
+    report("utf8", buf, len, expected, got);
+  got = jjson__validate_utf8_scalar(buf, len);
+  if (got != expected)
+    report("utf8 scalar", buf, len, expected, got);
+#if defined(JJSON__SSSE3)
+  got = jjson__validate_utf8_ssse3(buf, len);
+  if (got != expected)
+    report("utf8 ssse3", buf, len, expected, got);
+#endif
+#if defined(JJSON__AVX2)
+  got = jjson__validate_utf8_avx2(buf, len);
+  if (got != expected)
+    report("utf8 avx2", buf, len, expected, got);
+#endif
+}
+
+static void check_string(const char *buf, size_t len)
+{
+  for (size_t start = 0; start < len && start < 3; ++start)
+  {
+    unsigned expected_flags = 0, got_flags = 0;
+    size_t expected = ref_scan_string_special(buf, start, len, &expected_flags);
+    size_t got = jjson__scan_string_special(buf, start, len, &got_flags);
+    if (got != expected || got_flags != expected_flags)
+      report("scan_string_special", buf, len, expected, got);
+  }
+
+  size_t expected = ref_scan_string(buf, len);
+  size_t end = 0;
+  unsigned flags = 0;
+  size_t got = JJE_OK == jjson__scan_string(buf, 0, len, &end, &flags) ? end : (size_t)-1;
+  if (got != expected)
+  {
+    report("scan_string", buf, len, expected, got);
+    return;
+  }
+  if (got == (size_t)-1)
+    return;
+  char expected_out[1024];
+  char got_out[1024];
+  size_t expected_len = ref_decode_string(buf, end, expected_out);
+  size_t got_len = jjson__decode_string(buf, 0, end, got_out);
+  if (got_len != expected_len || memcmp(got_out, expected_out, got_len) != 0)
+    report("decode_string", buf, len, expected_len, got_len);
+}
+
+static void check_escape(const char *buf, size_t len)
+{
+  for (int ascii_only = 0; ascii_only <= 1; ++ascii_only)
+  {
+    for (size_t start = 0; start < len && start < 3; ++start)
+    {
+      size_t expected = ref_needs_escape(buf, start, len, ascii_only);
+      size_t got = jjson__scan_needs_escape(buf, start, len, ascii_only);
+      if (got != expected)
+        report(ascii_only ? "scan_needs_escape ascii" : "scan_needs_escape", buf, len, expected, got);
+    }
+  }
+
+  // the stringifier works on NUL-terminated strings
+  char str[1024];
+  size_t str_len = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (buf[i])
+      str[str_len++] = buf[i];
+  }
+  str[str_len] = '\0';
+  char expected_out[8192];
+  size_t expected_len = ref_escape_string(str, str_len, expected_out);
+  char *got_out = NULL;
+  size_t got_len = 0;
+  jjson__stringfier ctx = {open_memstream(&got_out, &got_len), 0, 0, 0};
+  jjson__stringify_string(&ctx, str);
+  fclose(ctx.stream);
+  if (got_len != expected_len || memcmp(got_out, expected_out, got_len) != 0)
+    report("stringify_string", buf, len, expected_len, got_len);
+  free(got_out);
+}
+
+// A valid sequence put at every offset of an ASCII buffer, then broken one byte at a time
+static void check_placed(const char *seq, size_t seq_len, void (*check)(const char *, size_t))
+{
+  char buf[96];
+  for (size_t len = seq_len; len <= 70; ++len)
+  {
+    for (size_t at = 0; at + seq_len <= len; ++at)
+    {
+      memset(buf, 'x', len);
+      memcpy(buf + at, seq, seq_len);
+      check(buf, len);
+      for (size_t k = 0; k < seq_len; ++k)
+      {
+        char saved = buf[at + k];
+        buf[at + k] = (char)0x80;
+        check(buf, len);
+        buf[at + k] = (char)0xC0;
+        check(buf, len);
+        buf[at + k] = saved;
+      }
+      // cut short by the end of the buffer
+      check(buf, at + seq_len - 1);
+    }
+  }
+}
+
+static void check_utf8_placed(const char *buf, size_t len)
+{
+  check_utf8(buf, len);
+}
+
+// Wraps `buf` in quotes so the escape and the string end land on lane edges
+static void check_string_placed(const char *buf, size_t len)
+{
+  char quoted[128];
+  memcpy(quoted, buf, len);
+  quoted[len] = '"';
+  check_string(quoted, len + 1);
+}
+
+// Values found by jjson_scan in `buf`, as start/end pairs, with the error offset last
+static size_t scan_all(const char *buf, size_t len, size_t split, size_t *found)
+{
+  jjson_scanner sc;
+  jjson_scanner_init(&sc);
+  size_t n = 0;
+  size_t start;
+  size_t end;
+  enum jjson_error err;
+  // the first call only sees `buf[0..split)` and is told more is coming
+  while (JJE_OK == (err = jjson_scan(&sc, buf, split, 1, &start, &end)))
+  {
+    found[n++] = start;
+    found[n++] = end;
+  }
+  if (JJE_NOT_FOUND == err)
+  {
+    while (JJE_OK == (err = jjson_scan(&sc, buf, len, 0, &start, &end)))
+    {
+      found[n++] = start;
+      found[n++] = end;
+    }
+  }
+  found[n++] = JJE_OK == err || JJE_NOT_FOUND == err ? (size_t)-1 : end;
+  return n;
+}
+
+static void check_scan(const char *buf)
+{
+  size_t len = strlen(buf);
+  size_t expected[64];
+  size_t got[64];
+  size_t expected_n = scan_all(buf, len, 0, expected);
+  for (size_t split = 1; split <= len; ++split)
+  {
+    size_t got_n = scan_all(buf, len, split, got);
+    if (got_n != expected_n || memcmp(got, expected, got_n * sizeof(size_t)) != 0)
+      report("scan", buf, len, expected[expected_n - 1], split);
+  }
+}
+
+int main(void)
+{
+  char buf[512];
+  for (size_t len = 0; len <= 65; ++len)
+  {
+    for (int round = 0; round < 3000; ++round)
+    {
+      fill_random(buf, len);
+      check_utf8(buf, len);
+      check_string(buf, len);
+      check_escape(buf, len);
+    }
+  }
+  for (int round = 0; round < 2000; ++round)
+  {
+    size_t len = 66 + rng() % (sizeof(buf) - 66);
+    fill_random(buf, len);
+    check_utf8(buf, len);
+    check_string(buf, len);
+    check_escape(buf, len);
+  }
+
+  // the valid extremes of each class, then overlong, surrogate and too large ones
+  static const char *const sequences[] = {
+      "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80", "\xED\x9F\xBF", "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF",
+      "\xC1\xBF", "\xE0\x9F\xBF", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80"};
+  for (size_t k = 0; k < sizeof(sequences) / sizeof(sequences[0]); ++k)
+  {
+    check_placed(sequences[k], strlen(sequences[k]), check_utf8_placed);
+    check_placed(sequences[k], strlen(sequences[k]), check_string_placed);
+  }
+  static const char *const escapes[] = {"\\n", "\\\"", "\\\\", "\\u00e9", "\\u20AC", "\\uD83D\\uDE00", "\\uD83D", "\\uDE00"};
+  for (size_t k = 0; k < sizeof(escapes) / sizeof(escapes[0]); ++k)
+  {
+    check_placed(escapes[k], strlen(escapes[k]), check_string_placed);
+  }
+  // bytes the stringifier has to escape, at every lane position
+  static const char *const specials[] = {"\"", "\\", "\n", "\x01", "\x1f", "\xc3\xa9", "\xff"};
+  for (size_t k = 0; k < sizeof(specials) / sizeof(specials[0]); ++k)
+  {
+    check_placed(specials[k], strlen(specials[k]), check_escape);
+  }
+  // streams cut at every byte: inside strings, escapes, numbers and literals
+  static const char *const streams[] = {
+      "{\"a\": [1, -2.5e+3, true, null], \"b\\u00e9\": {\"c\": \"\\uD83D\\uDE00\xc3\xa9\"}}\n{}",
+      "123 456\n\"x\" false [[]] {\"k\":{}}",
+      "{\"a\": 1}\n{\"a\": [1}",
+      "[1, 2, ]",
+      "{\"a\" 1}",
+      "[\"\\u12x4\"]",
+      "tru false",
+      "[3 4]",
+      "\"unterminated"};
+  for (size_t k = 0; k < sizeof(streams) / sizeof(streams[0]); ++k)
+  {
+    check_scan(streams[k]);
+  }
+
+  if (failures)
+  {
+    printf("%zu mismatches\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,1030 @@
+/*
+ * jack - streaming query tool for JSON and NDJSON
+ *
+ *   cc -O2 -march=native -I. tools/jack.c -o jack -lpthread
+ *
+ * or `cmake -B build && cmake --build build`, which also builds the examples.
+ *
+ * usage: jack [-t threads] [-s] <filter> [file]
+ *
+ * The filter is a small jq subset, applied to every top-level value of the
+ * input (one per line for NDJSON, or any whitespace-separated sequence):
+ *
+ *   .                        the whole value
+ *   .a.b[2]."odd key"        path selection, missing members give null
+ *   select(.a.b == 500)      keep values where the comparison holds
+ *                            (==, !=, <, <=, >, >=)
+ *   {.a, .b.c}               object of the selected members, keyed by the
+ *                            last path step
+ *   stage | stage            pipeline, e.g. select(.status >= 500) | {.path}
+ *
+ * Values are checked with jjson_scan as they are read, then walked as text
+ * rather than parsed: members that are not selected are skipped without being
+ * materialized, and selected ones are copied out minified. Files are mmap'd,
+ * stdin is read in chunks, so memory only grows with the largest value.
+ * With -t the file is split into blocks at newlines (NDJSON only) and
+ * processed by that many threads, output order preserved. -s prints
+ * throughput to stderr.
+ */
+
+#define JACK_IMPLEMENTATION
+#include "../jack.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+// returned by the scanning functions instead of an index
+#define CLI_BAD ((size_t)-1)
+// room for the problem reported with an invalid input offset
+#define CLI_REASON_SIZE 256
+
+#define CLI_READ_CHUNK (1 << 20)
+#define CLI_FLUSH_SIZE (1 << 20)
+#define CLI_BLOCK_SIZE (8 << 20)
+
+typedef enum
+{
+  CLI_STAGE_PATH,
+  CLI_STAGE_SELECT,
+  CLI_STAGE_PROJECT,
+} cli_stage_kind;
+
+typedef enum
+{
+  CLI_OP_EQ,
+  CLI_OP_NE,
+  CLI_OP_LT,
+  CLI_OP_LE,
+  CLI_OP_GT,
+  CLI_OP_GE,
+} cli_op;
+
+typedef struct
+{
+  int is_index;
+  size_t index;
+  // decoded member name
+  char *key;
+  size_t key_len;
+  // member name as written in the filter, quoted, used as projection key
+  char *json_key;
+} cli_step;
+
+typedef struct
+{
+  cli_step *steps;
+  size_t count;
+} cli_path;
+
+typedef struct
+{
+  cli_stage_kind kind;
+  cli_path path;
+  cli_op op;
+  char *literal;
+  size_t literal_len;
+  cli_path *fields;
+  size_t field_count;
+} cli_stage;
+
+typedef struct
+{
+  cli_stage *stages;
+  size_t count;
+} cli_filter;
+
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t cap;
+  // written to and emptied past CLI_FLUSH_SIZE, NULL to keep everything
+  FILE *flush;
+} cli_buffer;
+
+typedef struct
+{
+  size_t records;
+  size_t matched;
+} cli_stats;
+
+/**
+ * Scanning
+ */
+
+void cli_out_of_memory(void)
+{
+  fprintf(stderr, "jack: out of memory\n");
+  exit(1);
+}
+
+void *cli_malloc(size_t size)
+{
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    cli_out_of_memory();
+  return p;
+}
+
+size_t cli_skip_space(const char *s, size_t i, size_t end)
+{
+  while (i < end && (s[i] == ' ' || s[i] == '\n' || s[i] == '\r' || s[i] == '\t'))
+    i += 1;
+  return i;
+}
+
+// Returns the index just past the value starting at `s[i]`, or CLI_BAD when it is malformed
+size_t cli_skip_value(const char *s, size_t i, size_t end)
+{
+  jjson_scanner sc;
+  jjson_scanner_init(&sc);
+  sc.pos = i;
+  size_t start;
+  size_t value_end;
+  if (JJE_OK != jjson_scan(&sc, s, end, 0, &start, &value_end) || start != i)
+    return CLI_BAD;
+  return value_end;
+}
+
+/*
+ * Decodes the string contents `s[0..len)`. Points into `s` when there is
+ * nothing to unescape, otherwise into `*owned`, which the caller frees.
+ */
+const char *cli_decode(const char *s, size_t len, size_t *out_len, char **owned)
+{
+  *owned = NULL;
+  *out_len = len;
+  if (!memchr(s, '\\', len))
+    return s;
+  *owned = (char *)cli_malloc(len);
+  *out_len = jjson_unescape(s, len, *owned);
+  return *owned;
+}
+
+int cli_key_equals(const char *s, size_t start, size_t end, const cli_step *step)
+{
+  // escapes only ever shrink a key
+  if (end - start < step->key_len)
+    return 0;
+  char *owned;
+  size_t len;
+  const char *key = cli_decode(s + start, end - start, &len, &owned);
+  int equal = len == step->key_len && memcmp(key, step->key, len) == 0;
+  free(owned);
+  return equal;
+}
+
+/*
+ * Walks `path` from the value at `s[*start]` and narrows [*start, *end) to the
+ * selected value. Returns 0 when a step is missing or hits the wrong type.
+ * The value has already been checked by jjson_scan.
+ */
+int cli_lookup(const char *s, size_t *start, size_t *end, const cli_path *path)
+{
+  size_t i = *start;
+  size_t limit = *end;
+  for (size_t k = 0; k < path->count; ++k)
+  {
+    const cli_step *step = &path->steps[k];
+    i = cli_skip_space(s, i, limit);
+    if (i >= limit || s[i] != (step->is_index ? '[' : '{'))
+      return 0;
+    i = cli_skip_space(s, i + 1, limit);
+    size_t seen = 0;
+    int found = 0;
+    while (!found && i < limit && s[i] != ']' && s[i] != '}')
+    {
+      if (step->is_index)
+      {
+        found = seen++ == step->index;
+      }
+      else
+      {
+        size_t key_end = cli_skip_value(s, i, limit);
+        if (s[i] != '"' || key_end == CLI_BAD)
+          return 0;
+        found = cli_key_equals(s, i + 1, key_end - 1, step);
+        i = cli_skip_space(s, key_end, limit);
+        if (i >= limit || s[i] != ':')
+          return 0;
+        i = cli_skip_space(s, i + 1, limit);
+      }
+      if (found)
+        break;
+      i = cli_skip_value(s, i, limit);
+      if (i == CLI_BAD)
+        return 0;
+      i = cli_skip_space(s, i, limit);
+      if (i < limit && s[i] == ',')
+        i = cli_skip_space(s, i + 1, limit);
+    }
+    if (!found)
+      return 0;
+  }
+  i = cli_skip_space(s, i, limit);
+  size_t value_end = cli_skip_value(s, i, limit);
+  if (value_end == CLI_BAD)
+    return 0;
+  *start = i;
+  *end = value_end;
+  return 1;
+}
+
+/**
+ * Comparison
+ */
+
+typedef struct
+{
+  // decoded member name, NULL for array items
+  const char *key;
+  size_t key_len;
+  char *owned_key;
+  // position in the container, later duplicates of a key win
+  size_t index;
+  const char *value;
+  size_t value_len;
+} cli_member;
+
+// jq's order between types: null < false < true < numbers < strings < arrays < objects
+int cli_rank(char c)
+{
+  switch (c)
+  {
+  case 'n':
+    return 0;
+  case 'f':
+    return 1;
+  case 't':
+    return 2;
+  case '"':
+    return 4;
+  case '[':
+    return 5;
+  case '{':
+    return 6;
+  default:
+    return 3;
+  }
+}
+
+double cli_number(const char *s, size_t len)
+{
+  char buf[64];
+  char *text = len < sizeof(buf) ? buf : (char *)cli_malloc(len + 1);
+  memcpy(text, s, len);
+  text[len] = '\0';
+  double value = strtod(text, NULL);
+  if (text != buf)
+    free(text);
+  return value;
+}
+
+int cli_compare_bytes(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+  int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+  if (cmp != 0)
+    return cmp;
+  return (a_len > b_len) - (a_len < b_len);
+}
+
+int cli_compare_members(const void *x, const void *y)
+{
+  const cli_member *a = (const cli_member *)x;
+  const cli_member *b = (const cli_member *)y;
+  int cmp = cli_compare_bytes(a->key, a->key_len, b->key, b->key_len);
+  if (cmp != 0)
+    return cmp;
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+/*
+ * Splits the container `s[0..len)` into its items or members. Members are
+ * sorted by key with only the last of duplicate keys kept, as jq does.
+ */
+cli_member *cli_split(const char *s, size_t len, size_t *count)
+{
+  int is_object = s[0] == '{';
+  cli_member *members = NULL;
+  size_t n = 0;
+  size_t cap = 0;
+  size_t i = cli_skip_space(s, 1, len);
+  while (s[i] != '}' && s[i] != ']')
+  {
+    if (n == cap)
+    {
+      cap = cap ? cap * 2 : 8;
+      members = (cli_member *)realloc(members, sizeof(cli_member) * cap);
+      if (!members)
+        cli_out_of_memory();
+    }
+    cli_member *m = &members[n];
+    memset(m, 0, sizeof(*m));
+    m->index = n;
+    if (is_object)
+    {
+      size_t key_end = cli_skip_value(s, i, len);
+      m->key = cli_decode(s + i + 1, key_end - i - 2, &m->key_len, &m->owned_key);
+      // past ':'
+      i = cli_skip_space(s, cli_skip_space(s, key_end, len) + 1, len);
+    }
+    size_t value_end = cli_skip_value(s, i, len);
+    m->value = s + i;
+    m->value_len = value_end - i;
+    n += 1;
+    i = cli_skip_space(s, value_end, len);
+    if (s[i] == ',')
+      i = cli_skip_space(s, i + 1, len);
+  }
+  if (is_object && n > 1)
+  {
+    qsort(members, n, sizeof(cli_member), cli_compare_members);
+    size_t kept = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+      if (k + 1 < n && cli_compare_bytes(members[k].key, members[k].key_len, members[k + 1].key, members[k + 1].key_len) == 0)
+        free(members[k].owned_key);
+      else
+        members[kept++] = members[k];
+    }
+    n = kept;
+  }
+  *count = n;
+  return members;
+}
+
+void cli_free_members(cli_member *members, size_t count)
+{
+  for (size_t k = 0; k < count; ++k)
+    free(members[k].owned_key);
+  free(members);
+}
+
+/*
+ * Three-way comparison of two checked JSON values given as text, in jq's
+ * order: numbers and strings by value, arrays item by item, objects by their
+ * sorted keys and then by the values under those keys.
+ */
+int cli_compare(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+  int rank_a = cli_rank(a[0]);
+  int rank_b = cli_rank(b[0]);
+  if (rank_a != rank_b)
+    return rank_a - rank_b;
+  if (rank_a < 3)
+    return 0;
+  if (rank_a == 3)
+  {
+    double x = cli_number(a, a_len);
+    double y = cli_number(b, b_len);
+    return (x > y) - (x < y);
+  }
+  if (rank_a == 4)
+  {
+    char *owned_a;
+    char *owned_b;
+    size_t x;
+    size_t y;
+    const char *text_a = cli_decode(a + 1, a_len - 2, &x, &owned_a);
+    const char *text_b = cli_decode(b + 1, b_len - 2, &y, &owned_b);
+    int cmp = cli_compare_bytes(text_a, x, text_b, y);
+    free(owned_a);
+    free(owned_b);
+    return cmp;
+  }
+  size_t count_a;
+  size_t count_b;
+  cli_member *members_a = cli_split(a, a_len, &count_a);
+  cli_member *members_b = cli_split(b, b_len, &count_b);
+  size_t common = count_a < count_b ? count_a : count_b;
+  int cmp = 0;
+  // objects with different key sets are ordered by the keys alone
+  if (rank_a == 6)
+  {
+    for (size_t k = 0; cmp == 0 && k < common; ++k)
+      cmp = cli_compare_bytes(members_a[k].key, members_a[k].key_len, members_b[k].key, members_b[k].key_len);
+    if (cmp == 0)
+      cmp = (count_a > count_b) - (count_a < count_b);
+  }
+  for (size_t k = 0; cmp == 0 && k < common; ++k)
+    cmp = cli_compare(members_a[k].value, members_a[k].value_len, members_b[k].value, members_b[k].value_len);
+  if (cmp == 0)
+    cmp = (count_a > count_b) - (count_a < count_b);
+  cli_free_members(members_a, count_a);
+  cli_free_members(members_b, count_b);
+  return cmp;
+}
+
+int cli_holds(cli_op op, int cmp)
+{
+  switch (op)
+  {
+  case CLI_OP_EQ:
+    return cmp == 0;
+  case CLI_OP_NE:
+    return cmp != 0;
+  case CLI_OP_LT:
+    return cmp < 0;
+  case CLI_OP_LE:
+    return cmp <= 0;
+  case CLI_OP_GT:
+    return cmp > 0;
+  case CLI_OP_GE:
+    return cmp >= 0;
+  }
+  return 0;
+}
+
+/**
+ * Output
+ */
+
+void cli_buffer_reserve(cli_buffer *out, size_t extra)
+{
+  if (out->len + extra <= out->cap)
+    return;
+  size_t cap = out->cap ? out->cap : 4096;
+  while (cap < out->len + extra)
+    cap *= 2;
+  char *data = (char *)realloc(out->data, cap);
+  if (!data)
+    cli_out_of_memory();
+  out->data = data;
+  out->cap = cap;
+}
+
+void cli_buffer_write(cli_buffer *out, const char *s, size_t len)
+{
+  cli_buffer_reserve(out, len);
+  memcpy(out->data + out->len, s, len);
+  out->len += len;
+}
+
+// `s` has been checked by jjson_scan, so minifying it cannot fail
+void cli_buffer_value(cli_buffer *out, const char *s, size_t len)
+{
+  cli_buffer_reserve(out, len);
+  size_t written = 0;
+  jjson_minify(s, len, out->data + out->len, &written);
+  out->len += written;
+}
+
+void cli_buffer_flush(cli_buffer *out)
+{
+  if (out->flush && out->len)
+  {
+    fwrite(out->data, 1, out->len, out->flush);
+    out->len = 0;
+  }
+}
+
+/**
+ * Evaluation
+ */
+
+// Applies the filter to one checked value and appends its result, if any, to `out`
+void cli_eval(const cli_filter *filter, const char *s, size_t start, size_t end, cli_buffer *out, cli_stats *stats)
+{
+  int present = 1;
+  stats->records += 1;
+  for (size_t k = 0; k < filter->count; ++k)
+  {
+    const cli_stage *stage = &filter->stages[k];
+    switch (stage->kind)
+    {
+    case CLI_STAGE_PATH:
+      present = present && cli_lookup(s, &start, &end, &stage->path);
+      break;
+    case CLI_STAGE_SELECT:
+    {
+      size_t value_start = start;
+      size_t value_end = end;
+      int found = present && cli_lookup(s, &value_start, &value_end, &stage->path);
+      const char *value = found ? s + value_start : "null";
+      size_t value_len = found ? value_end - value_start : 4;
+      if (!cli_holds(stage->op, cli_compare(value, value_len, stage->literal, stage->literal_len)))
+        return;
+      break;
+    }
+    case CLI_STAGE_PROJECT:
+    {
+      stats->matched += 1;
+      cli_buffer_write(out, "{", 1);
+      for (size_t f = 0; f < stage->field_count; ++f)
+      {
+        const cli_path *field = &stage->fields[f];
+        const char *key = field->steps[field->count - 1].json_key;
+        size_t field_start = start;
+        size_t field_end = end;
+        if (f > 0)
+          cli_buffer_write(out, ",", 1);
+        cli_buffer_write(out, key, strlen(key));
+        cli_buffer_write(out, ":", 1);
+        if (present && cli_lookup(s, &field_start, &field_end, field))
+          cli_buffer_value(out, s + field_start, field_end - field_start);
+        else
+          cli_buffer_write(out, "null", 4);
+      }
+      cli_buffer_write(out, "}\n", 2);
+      return;
+    }
+    }
+  }
+  stats->matched += 1;
+  if (!present)
+  {
+    cli_buffer_write(out, "null\n", 5);
+    return;
+  }
+  cli_buffer_value(out, s + start, end - start);
+  cli_buffer_write(out, "\n", 1);
+}
+
+// Keeps the problem described by jjson_strerror without its offset, which the caller reports for the whole input
+void cli_error_reason(char *reason)
+{
+  const char *msg = jjson_strerror();
+  const char *prefix = "[JSON ERROR]: ";
+  if (strncmp(msg, prefix, strlen(prefix)) == 0)
+    msg += strlen(prefix);
+  const char *at = strstr(msg, " at offset ");
+  snprintf(reason, CLI_REASON_SIZE, "%.*s", (int)(at ? (size_t)(at - msg) : strlen(msg)), msg);
+}
+
+/*
+ * Evaluates every value that `sc` finds in `s[sc->pos..end)`. Returns the
+ * index where the value still being read starts, so the caller may drop the
+ * input before it (only when `more` says input continues, `end` otherwise),
+ * or CLI_BAD with `*bad_at` and `reason` set.
+ */
+size_t cli_run(const cli_filter *filter, jjson_scanner *sc, const char *s, size_t end, int more, cli_buffer *out, cli_stats *stats, size_t *bad_at, char *reason)
+{
+  size_t start;
+  size_t value_end;
+  enum jjson_error err;
+  while (JJE_OK == (err = jjson_scan(sc, s, end, more, &start, &value_end)))
+  {
+    cli_eval(filter, s, start, value_end, out, stats);
+    if (out->len >= CLI_FLUSH_SIZE)
+      cli_buffer_flush(out);
+  }
+  if (JJE_NOT_FOUND == err)
+    return sc->start;
+  *bad_at = value_end;
+  cli_error_reason(reason);
+  return CLI_BAD;
+}
+
+/**
+ * Threads
+ */
+
+typedef struct
+{
+  const cli_filter *filter;
+  const char *s;
+  size_t len;
+  // threads actually running, set before the workers pass the lock
+  size_t n_threads;
+  size_t n_blocks;
+  pthread_barrier_t barrier;
+  cli_buffer *outs;
+  cli_stats *stats;
+  // first failing offset, CLI_BAD when none
+  size_t bad_at;
+  char reason[CLI_REASON_SIZE];
+  pthread_mutex_t lock;
+} cli_pool;
+
+typedef struct
+{
+  cli_pool *pool;
+  size_t id;
+} cli_worker;
+
+// Start of block `k`, moved forward to just after a newline
+size_t cli_block_start(const cli_pool *pool, size_t k)
+{
+  if (k == 0)
+    return 0;
+  size_t at = k * CLI_BLOCK_SIZE;
+  if (at >= pool->len)
+    return pool->len;
+  const char *nl = (const char *)memchr(pool->s + at, '\n', pool->len - at);
+  return nl ? (size_t)(nl - pool->s) + 1 : pool->len;
+}
+
+void *cli_worker_main(void *arg)
+{
+  cli_worker *worker = (cli_worker *)arg;
+  cli_pool *pool = worker->pool;
+  // held by cli_run_threads until it knows how many threads started
+  pthread_mutex_lock(&pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t round = 0; round * pool->n_threads < pool->n_blocks; ++round)
+  {
+    size_t k = round * pool->n_threads + worker->id;
+    if (k < pool->n_blocks && pool->bad_at == CLI_BAD)
+    {
+      size_t bad_at;
+      char reason[CLI_REASON_SIZE];
+      jjson_scanner sc;
+      jjson_scanner_init(&sc);
+      sc.pos = cli_block_start(pool, k);
+      size_t end = cli_block_start(pool, k + 1);
+      if (cli_run(pool->filter, &sc, pool->s, end, 0, &pool->outs[worker->id], &pool->stats[worker->id], &bad_at, reason) == CLI_BAD)
+      {
+        pthread_mutex_lock(&pool->lock);
+        if (bad_at < pool->bad_at)
+        {
+          pool->bad_at = bad_at;
+          memcpy(pool->reason, reason, sizeof(reason));
+        }
+        pthread_mutex_unlock(&pool->lock);
+      }
+    }
+    pthread_barrier_wait(&pool->barrier);
+    if (worker->id == 0)
+    {
+      for (size_t t = 0; t < pool->n_threads; ++t)
+      {
+        if (pool->outs[t].len)
+          fwrite(pool->outs[t].data, 1, pool->outs[t].len, stdout);
+        pool->outs[t].len = 0;
+      }
+    }
+    pthread_barrier_wait(&pool->barrier);
+  }
+  return NULL;
+}
+
+size_t cli_run_threads(const cli_filter *filter, const char *s, size_t len, size_t n_threads, cli_stats *total, char *reason)
+{
+  cli_pool pool;
+  pool.filter = filter;
+  pool.s = s;
+  pool.len = len;
+  pool.n_blocks = (len + CLI_BLOCK_SIZE - 1) / CLI_BLOCK_SIZE;
+  pool.bad_at = CLI_BAD;
+  pool.outs = (cli_buffer *)calloc(n_threads, sizeof(cli_buffer));
+  pool.stats = (cli_stats *)calloc(n_threads, sizeof(cli_stats));
+  cli_worker *workers = (cli_worker *)calloc(n_threads, sizeof(cli_worker));
+  pthread_t *threads = (pthread_t *)calloc(n_threads, sizeof(pthread_t));
+  if (!pool.outs || !pool.stats || !workers || !threads)
+    cli_out_of_memory();
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_mutex_lock(&pool.lock);
+  size_t started = 1;
+  for (size_t t = 0; t < n_threads; ++t)
+  {
+    workers[t].pool = &pool;
+    workers[t].id = t;
+  }
+  while (started < n_threads && pthread_create(&threads[started], NULL, cli_worker_main, &workers[started]) == 0)
+    started += 1;
+  if (started < n_threads)
+    fprintf(stderr, "jack: could only start %zu of %zu threads\n", started, n_threads);
+  // the blocks are shared among the threads that did start, down to this one alone
+  pool.n_threads = started;
+  pthread_barrier_init(&pool.barrier, NULL, (unsigned)started);
+  pthread_mutex_unlock(&pool.lock);
+  cli_worker_main(&workers[0]);
+  for (size_t t = 1; t < started; ++t)
+    pthread_join(threads[t], NULL);
+  for (size_t t = 0; t < started; ++t)
+  {
+    total->records += pool.stats[t].records;
+    total->matched += pool.stats[t].matched;
+    free(pool.outs[t].data);
+  }
+  if (pool.bad_at != CLI_BAD)
+    memcpy(reason, pool.reason, CLI_REASON_SIZE);
+  pthread_barrier_destroy(&pool.barrier);
+  pthread_mutex_destroy(&pool.lock);
+  free(pool.outs);
+  free(pool.stats);
+  free(workers);
+  free(threads);
+  return pool.bad_at;
+}
+
+/**
+ * Filter Parsing
+ */
+
+typedef struct
+{
+  const char *s;
+  size_t pos;
+  size_t len;
+} cli_cursor;
+
+void cli_filter_error(const cli_cursor *c, const char *what)
+{
+  fprintf(stderr, "jack: %s at column %zu of filter\n  %s\n  %*s^\n", what, c->pos + 1, c->s, (int)c->pos, "");
+  exit(2);
+}
+
+void cli_skip_blank(cli_cursor *c)
+{
+  c->pos = cli_skip_space(c->s, c->pos, c->len);
+}
+
+int cli_accept(cli_cursor *c, const char *word)
+{
+  cli_skip_blank(c);
+  size_t n = strlen(word);
+  if (c->len - c->pos < n || memcmp(c->s + c->pos, word, n) != 0)
+    return 0;
+  c->pos += n;
+  return 1;
+}
+
+void cli_push_step(cli_path *path, cli_step step)
+{
+  path->steps = (cli_step *)realloc(path->steps, sizeof(cli_step) * (path->count + 1));
+  if (!path->steps)
+    cli_out_of_memory();
+  path->steps[path->count++] = step;
+}
+
+void cli_parse_key(cli_cursor *c, cli_path *path)
+{
+  cli_step step = {0};
+  size_t start = c->pos;
+  if (c->s[c->pos] == '"')
+  {
+    size_t end = cli_skip_value(c->s, start, c->len);
+    if (end == CLI_BAD)
+      cli_filter_error(c, "invalid string");
+    step.key = (char *)cli_malloc(end - start);
+    step.key_len = jjson_unescape(c->s + start + 1, end - start - 2, step.key);
+    step.json_key = strndup(c->s + start, end - start);
+    c->pos = end;
+  }
+  else
+  {
+    while (c->pos < c->len && (isalnum((unsigned char)c->s[c->pos]) || c->s[c->pos] == '_'))
+      c->pos += 1;
+    if (c->pos == start)
+      cli_filter_error(c, "expected a member name");
+    step.key = strndup(c->s + start, c->pos - start);
+    step.key_len = c->pos - start;
+    step.json_key = (char *)malloc(step.key_len + 3);
+    sprintf(step.json_key, "\"%s\"", step.key);
+  }
+  cli_push_step(path, step);
+}
+
+void cli_parse_path(cli_cursor *c, cli_path *path)
+{
+  if (!cli_accept(c, "."))
+    cli_filter_error(c, "expected a path starting with '.'");
+  if (c->pos < c->len && c->s[c->pos] != '[' && c->s[c->pos] != '.' && !strchr(" \t\n\r|,}=!<>)", c->s[c->pos]))
+    cli_parse_key(c, path);
+  while (c->pos < c->len)
+  {
+    if (c->s[c->pos] == '.')
+    {
+      c->pos += 1;
+      cli_parse_key(c, path);
+    }
+    else if (c->s[c->pos] == '[')
+    {
+      char *digits_end;
+      cli_step step = {0};
+      step.is_index = 1;
+      step.index = strtoul(c->s + c->pos + 1, &digits_end, 10);
+      if (digits_end == c->s + c->pos + 1 || *digits_end != ']')
+        cli_filter_error(c, "expected an array index");
+      c->pos = (size_t)(digits_end - c->s) + 1;
+      cli_push_step(path, step);
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+void cli_parse_select(cli_cursor *c, cli_stage *stage)
+{
+  static const struct
+  {
+    const char *text;
+    cli_op op;
+  } ops[] = {{"==", CLI_OP_EQ}, {"!=", CLI_OP_NE}, {"<=", CLI_OP_LE}, {">=", CLI_OP_GE}, {"<", CLI_OP_LT}, {">", CLI_OP_GT}};
+  stage->kind = CLI_STAGE_SELECT;
+  cli_parse_path(c, &stage->path);
+  size_t k = 0;
+  while (k < sizeof(ops) / sizeof(ops[0]) && !cli_accept(c, ops[k].text))
+    k += 1;
+  if (k == sizeof(ops) / sizeof(ops[0]))
+    cli_filter_error(c, "expected a comparison");
+  stage->op = ops[k].op;
+  cli_skip_blank(c);
+  size_t start = c->pos;
+  // ')' ends a number, so the literal can be scanned in place
+  size_t end = cli_skip_value(c->s, start, c->len);
+  if (end == CLI_BAD)
+    cli_filter_error(c, "expected a JSON literal");
+  stage->literal = strndup(c->s + start, end - start);
+  stage->literal_len = end - start;
+  c->pos = end;
+  if (!cli_accept(c, ")"))
+    cli_filter_error(c, "expected ')'");
+}
+
+void cli_parse_project(cli_cursor *c, cli_stage *stage)
+{
+  stage->kind = CLI_STAGE_PROJECT;
+  do
+  {
+    stage->fields = (cli_path *)realloc(stage->fields, sizeof(cli_path) * (stage->field_count + 1));
+    cli_path *field = &stage->fields[stage->field_count++];
+    memset(field, 0, sizeof(*field));
+    cli_parse_path(c, field);
+    if (field->count == 0 || field->steps[field->count - 1].is_index)
+      cli_filter_error(c, "projected paths must end with a member name");
+  } while (cli_accept(c, ","));
+  if (!cli_accept(c, "}"))
+    cli_filter_error(c, "expected '}'");
+}
+
+void cli_parse_filter(const char *text, cli_filter *filter)
+{
+  cli_cursor c = {text, 0, strlen(text)};
+  do
+  {
+    if (filter->count > 0 && filter->stages[filter->count - 1].kind == CLI_STAGE_PROJECT)
+      cli_filter_error(&c, "a projection must be the last stage");
+    filter->stages = (cli_stage *)realloc(filter->stages, sizeof(cli_stage) * (filter->count + 1));
+    cli_stage *stage = &filter->stages[filter->count++];
+    memset(stage, 0, sizeof(*stage));
+    if (cli_accept(&c, "select("))
+      cli_parse_select(&c, stage);
+    else if (cli_accept(&c, "{"))
+      cli_parse_project(&c, stage);
+    else
+      cli_parse_path(&c, &stage->path);
+  } while (cli_accept(&c, "|"));
+  cli_skip_blank(&c);
+  if (c.pos != c.len)
+    cli_filter_error(&c, "unexpected text");
+}
+
+/**
+ * Driver
+ */
+
+double cli_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void cli_usage(void)
+{
+  fprintf(stderr, "usage: jack [-t threads] [-s] <filter> [file]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  size_t n_threads = 1;
+  int show_stats = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:sh")) != -1)
+  {
+    switch (opt)
+    {
+    case 't':
+      n_threads = strtoul(optarg, NULL, 10);
+      if (n_threads == 0)
+        n_threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+      break;
+    case 's':
+      show_stats = 1;
+      break;
+    default:
+      cli_usage();
+    }
+  }
+  if (optind >= argc || argc - optind > 2)
+    cli_usage();
+
+  cli_filter filter = {0};
+  cli_parse_filter(argv[optind], &filter);
+  const char *path = optind + 1 < argc ? argv[optind + 1] : "-";
+
+  static char stdout_buf[1 << 16];
+  setvbuf(stdout, stdout_buf, _IOFBF, sizeof(stdout_buf));
+
+  cli_stats stats = {0};
+  cli_buffer out = {0};
+  out.flush = stdout;
+  size_t bad_at = CLI_BAD;
+  char reason[CLI_REASON_SIZE] = "";
+  size_t total = 0;
+  double started = cli_now();
+
+  if (strcmp(path, "-") != 0)
+  {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+      perror(path);
+      return 1;
+    }
+    total = (size_t)st.st_size;
+    const char *s = "";
+    if (total > 0)
+    {
+      s = (const char *)mmap(NULL, total, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (s == MAP_FAILED)
+      {
+        perror(path);
+        return 1;
+      }
+      madvise((void *)s, total, MADV_SEQUENTIAL);
+    }
+    if (n_threads > 1)
+    {
+      bad_at = cli_run_threads(&filter, s, total, n_threads, &stats, reason);
+    }
+    else
+    {
+      jjson_scanner sc;
+      jjson_scanner_init(&sc);
+      cli_run(&filter, &sc, s, total, 0, &out, &stats, &bad_at, reason);
+    }
+  }
+  else
+  {
+    // values may span reads: the value still being read is kept for the next
+    // round and the scanner resumes inside it rather than at its start
+    if (n_threads > 1)
+      fprintf(stderr, "jack: -t needs a file, reading stdin on one thread\n");
+    jjson_scanner sc;
+    jjson_scanner_init(&sc);
+    size_t cap = 2 * CLI_READ_CHUNK;
+    char *s = (char *)cli_malloc(cap);
+    size_t len = 0;
+    int more = 1;
+    while (more && bad_at == CLI_BAD)
+    {
+      if (cap - len < CLI_READ_CHUNK)
+      {
+        cap *= 2;
+        s = (char *)realloc(s, cap);
+        if (!s)
+          cli_out_of_memory();
+      }
+      ssize_t got = read(STDIN_FILENO, s + len, cap - len);
+      if (got < 0)
+      {
+        perror("stdin");
+        return 1;
+      }
+      more = got > 0;
+      len += (size_t)got;
+      size_t done = cli_run(&filter, &sc, s, len, more, &out, &stats, &bad_at, reason);
+      if (done == CLI_BAD)
+      {
+        bad_at += total;
+        break;
+      }
+      memmove(s, s + done, len - done);
+      len -= done;
+      total += done;
+      sc.pos -= done;
+      sc.start -= done;
+    }
+    total += len;
+    free(s);
+  }
+  cli_buffer_flush(&out);
+  free(out.data);
+  fflush(stdout);
+
+  if (show_stats)
+  {
+    double elapsed = cli_now() - started;
+    fprintf(stderr, "jack: %zu bytes, %zu values, %zu output in %.3f s (%.1f MB/s)\n", total, stats.records, stats.matched, elapsed, elapsed > 0 ? total / elapsed / 1e6 : 0.0);
+  }
+  if (bad_at != CLI_BAD)
+  {
+    fprintf(stderr, "jack: invalid JSON at byte %zu: %s\n", bad_at, reason);
+    return 1;
+  }
+  return 0;
+}